@@ -0,0 +1,185 @@
+// deque.cc
+//	Routines to manage a double-ended queue kept as a ring buffer.
+//	Deques are implemented as templates so that we can store
+//	anything in them in a type-safe manner.
+//
+//	The items are elements[head], elements[head+1], ..., wrapping
+//	around at the end of the array, front first.
+//
+//     	NOTE: Mutual exclusion must be provided by the caller.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+const int DequeInitialSize = 16;	// elements allocated at first;
+					// must be a power of two
+
+//----------------------------------------------------------------------
+// Deque<T>::Deque
+//	Initialize an empty deque.
+//----------------------------------------------------------------------
+
+template <class T>
+Deque<T>::Deque()
+{
+    capacity = DequeInitialSize;
+    elements = new T[capacity];
+    head = 0;
+    numInDeque = 0;
+}
+
+//----------------------------------------------------------------------
+// Deque<T>::~Deque
+//	De-allocate the deque.  As with lists, de-allocating whatever
+//	the items point to is up to the caller.
+//----------------------------------------------------------------------
+
+template <class T>
+Deque<T>::~Deque()
+{
+    delete [] elements;
+}
+
+//----------------------------------------------------------------------
+// Deque<T>::Append
+//	Put an item at the back of the deque, doubling the array if it
+//	is full.
+//
+//	"item" is the thing to put in the deque
+//----------------------------------------------------------------------
+
+template <class T>
+void
+Deque<T>::Append(T item)
+{
+    if (numInDeque == capacity) {
+	T *bigger = new T[capacity * 2];
+
+	for (int i = 0; i < numInDeque; i++)
+	    bigger[i] = At(i);
+	delete [] elements;
+	elements = bigger;
+	capacity *= 2;
+	head = 0;
+    }
+    numInDeque++;
+    At(numInDeque - 1) = item;
+}
+
+//----------------------------------------------------------------------
+// Deque<T>::Front, Deque<T>::Back
+//	Return the item at the front (or back) of the deque, leaving it
+//	there.  The deque must not be empty.
+//----------------------------------------------------------------------
+
+template <class T>
+T
+Deque<T>::Front()
+{
+    ASSERT(!IsEmpty());
+    return At(0);
+}
+
+template <class T>
+T
+Deque<T>::Back()
+{
+    ASSERT(!IsEmpty());
+    return At(numInDeque - 1);
+}
+
+//----------------------------------------------------------------------
+// Deque<T>::RemoveFront, Deque<T>::RemoveBack
+//	Remove the item at the front (or back) of the deque, and return
+//	it.  The deque must not be empty.
+//----------------------------------------------------------------------
+
+template <class T>
+T
+Deque<T>::RemoveFront()
+{
+    T item;
+
+    ASSERT(!IsEmpty());
+    item = At(0);
+    head = (head + 1) & (capacity - 1);
+    numInDeque--;
+    return item;
+}
+
+template <class T>
+T
+Deque<T>::RemoveBack()
+{
+    ASSERT(!IsEmpty());
+    numInDeque--;
+    return At(numInDeque);
+}
+
+//----------------------------------------------------------------------
+// Deque<T>::Apply
+//	Apply function to every item in the deque, front first.
+//
+//	"f" -- the procedure to apply
+//----------------------------------------------------------------------
+
+template <class T>
+void
+Deque<T>::Apply(void (*f)(T)) const
+{
+    for (int i = 0; i < numInDeque; i++)
+	(*f)(At(i));
+}
+
+//----------------------------------------------------------------------
+// Deque<T>::SelfTest
+//	Test whether this module is working.  With its front away from
+//	the start of the array, the deque is filled until the array has
+//	to grow while the items wrap around its end -- twice, once more
+//	after the front has moved on again.  Then the items are taken
+//	off both ends, alternately, checking their order.
+//
+//	The k'th item appended is p[k % numEntries].
+//----------------------------------------------------------------------
+
+template <class T>
+void
+Deque<T>::SelfTest(T *p, int numEntries)
+{
+    int i, first, last;		// we have removed the items before
+				// the first'th, and appended those
+				// before the last'th
+
+    ASSERT(IsEmpty());
+    for (i = 0; i < DequeInitialSize / 2 + 1; i++) {
+	Append(p[0]);
+	(void) RemoveFront();
+    }
+    ASSERT(head != 0);
+
+    first = last = 0;
+    while (last - first <= DequeInitialSize)
+	Append(p[last++ % numEntries]);
+    ASSERT(capacity == 2 * DequeInitialSize);
+    for (i = 0; i < DequeInitialSize / 2 + 1; i++)
+	ASSERT(RemoveFront() == p[first++ % numEntries]);
+    ASSERT(head != 0);
+    while (last - first <= 2 * DequeInitialSize)
+	Append(p[last++ % numEntries]);
+    ASSERT(capacity == 4 * DequeInitialSize);
+    ASSERT(NumInDeque() == last - first);
+
+    while (!IsEmpty()) {
+	ASSERT(Front() == p[first % numEntries]);
+	ASSERT(RemoveFront() == p[first++ % numEntries]);
+	if (IsEmpty())
+	    break;
+	last--;
+	ASSERT(Back() == p[last % numEntries]);
+	ASSERT(RemoveBack() == p[last % numEntries]);
+    }
+    ASSERT(first == last);
+}
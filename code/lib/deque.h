@@ -0,0 +1,63 @@
+// deque.h
+//	Data structures to manage a double-ended queue, kept as a ring
+//	buffer in an array.
+//
+//	Items go in at the back, and normally come out of the front, as
+//	with a List used as a queue; they can also be taken off the back.
+//	A scheduler uses that to keep a per-processor queue of ready
+//	threads: the processor runs them from the front, and an idle
+//	processor steals from the back, where the threads that have
+//	waited least (and so have the least to lose by moving) are.
+//
+//	Like a Heap, the deque stores items by value in one array that
+//	only grows, so once it has reached its working size, putting
+//	items in and taking them out never allocates memory.
+//
+//	The type T must be copyable and have a default constructor.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef DEQUE_H
+#define DEQUE_H
+
+#include "copyright.h"
+#include "debug.h"
+
+template <class T>
+class Deque {
+  public:
+    Deque();				// initialize an empty deque
+    ~Deque();				// de-allocate the deque
+
+    void Append(T item);		// put an item at the back
+    T Front();				// return the item at the front,
+					// without removing it
+    T Back();				// same, for the item at the back
+    T RemoveFront();			// remove and return the front item
+    T RemoveBack();			// remove and return the back item
+
+    bool IsEmpty() { return numInDeque == 0; }
+    int NumInDeque() { return numInDeque; }
+
+    void Apply(void (*f)(T)) const;	// apply function to all elements,
+					// front first
+
+    void SelfTest(T *p, int numEntries);
+					// verify module is working
+
+  private:
+    T *elements;			// the ring buffer
+    int capacity;			// size of "elements"; a power of two
+    int head;				// index of the front item
+    int numInDeque;			// number of items in the deque
+
+    T &At(int i) const { return elements[(head + i) & (capacity - 1)]; }
+					// the i'th item from the front
+};
+
+#include "deque.cc"		// templates are really like macros
+				// so needs to be included in every
+				// file that uses the template
+#endif // DEQUE_H
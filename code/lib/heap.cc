@@ -0,0 +1,247 @@
+// heap.cc
+//	Routines to manage a priority queue kept as a binary min-heap.
+//	Heaps are implemented as templates so that we can store
+//	anything in them in a type-safe manner.
+//
+//	The heap lives in elements[0..numInHeap-1]; the children of
+//	element i are elements 2i+1 and 2i+2, and no element comes
+//	Before its parent.
+//
+//     	NOTE: Mutual exclusion must be provided by the caller.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+const int HeapInitialSize = 16;		// elements allocated at first
+
+//----------------------------------------------------------------------
+// Heap<T>::Heap
+//	Initialize an empty heap.
+//
+//	"comp" -- function that returns < 0 if its first argument should
+//		come out before its second, 0 if they are equal
+//----------------------------------------------------------------------
+
+template <class T>
+Heap<T>::Heap(int (*comp)(T x, T y))
+{
+    compare = comp;
+    numInHeap = 0;
+    capacity = HeapInitialSize;
+    elements = new HeapElement[capacity];
+    nextSeq = 0;
+}
+
+//----------------------------------------------------------------------
+// Heap<T>::~Heap
+//	De-allocate the heap.  As with lists, de-allocating whatever
+//	the items point to is up to the caller.
+//----------------------------------------------------------------------
+
+template <class T>
+Heap<T>::~Heap()
+{
+    delete [] elements;
+}
+
+//----------------------------------------------------------------------
+// Heap<T>::Before
+//	Return TRUE if "x" should come out of the heap before "y":
+//	it is smaller, or they are equal and "x" was put in first.
+//----------------------------------------------------------------------
+
+template <class T>
+bool
+Heap<T>::Before(const HeapElement &x, const HeapElement &y) const
+{
+    int result = compare(x.item, y.item);
+
+    if (result != 0)
+	return result < 0;
+    return (int) (x.seq - y.seq) < 0;	// correct across wrap-around
+}
+
+//----------------------------------------------------------------------
+// Heap<T>::SiftUp, Heap<T>::SiftDown
+//	Move element "i" of the heap "a" (of "n" elements) up towards
+//	the root, or down towards the leaves, until it is in order
+//	with its parent and children.
+//----------------------------------------------------------------------
+
+template <class T>
+void
+Heap<T>::SiftUp(HeapElement *a, int i) const
+{
+    HeapElement element = a[i];
+    int parent;
+
+    while (i > 0) {
+	parent = (i - 1) / 2;
+	if (!Before(element, a[parent]))
+	    break;
+	a[i] = a[parent];
+	i = parent;
+    }
+    a[i] = element;
+}
+
+template <class T>
+void
+Heap<T>::SiftDown(HeapElement *a, int n, int i) const
+{
+    HeapElement element = a[i];
+    int child;
+
+    for (;;) {
+	child = 2 * i + 1;
+	if (child >= n)
+	    break;
+	if (child + 1 < n && Before(a[child + 1], a[child]))
+	    child++;
+	if (!Before(a[child], element))
+	    break;
+	a[i] = a[child];
+	i = child;
+    }
+    a[i] = element;
+}
+
+//----------------------------------------------------------------------
+// Heap<T>::Insert
+//	Put an item in the heap, doubling the array if it is full.
+//
+//	"item" is the thing to put in the heap
+//----------------------------------------------------------------------
+
+template <class T>
+void
+Heap<T>::Insert(T item)
+{
+    if (numInHeap == capacity) {
+	HeapElement *bigger = new HeapElement[capacity * 2];
+
+	for (int i = 0; i < numInHeap; i++)
+	    bigger[i] = elements[i];
+	delete [] elements;
+	elements = bigger;
+	capacity *= 2;
+    }
+    elements[numInHeap].item = item;
+    elements[numInHeap].seq = nextSeq++;
+    SiftUp(elements, numInHeap);
+    numInHeap++;
+}
+
+//----------------------------------------------------------------------
+// Heap<T>::Front
+//	Return the smallest item in the heap, leaving it there.
+//	The heap must not be empty.
+//----------------------------------------------------------------------
+
+template <class T>
+T
+Heap<T>::Front()
+{
+    ASSERT(!IsEmpty());
+    return elements[0].item;
+}
+
+//----------------------------------------------------------------------
+// Heap<T>::RemoveFront
+//	Remove the smallest item from the heap, and return it.
+//	The heap must not be empty.
+//----------------------------------------------------------------------
+
+template <class T>
+T
+Heap<T>::RemoveFront()
+{
+    T item;
+
+    ASSERT(!IsEmpty());
+    item = elements[0].item;
+    numInHeap--;
+    if (numInHeap > 0) {
+	elements[0] = elements[numInHeap];
+	SiftDown(elements, numInHeap, 0);
+    }
+    return item;
+}
+
+//----------------------------------------------------------------------
+// Heap<T>::Apply
+//	Apply function to every item in the heap, in the order they
+//	would be removed.  Works on a copy, so it is slow; intended for
+//	debugging output only.
+//
+//	"f" -- the procedure to apply
+//----------------------------------------------------------------------
+
+template <class T>
+void
+Heap<T>::Apply(void (*f)(T)) const
+{
+    HeapElement *copy = new HeapElement[capacity];
+    int n = numInHeap;
+
+    for (int i = 0; i < n; i++)
+	copy[i] = elements[i];
+    while (n > 0) {
+	(*f)(copy[0].item);
+	n--;
+	copy[0] = copy[n];
+	SiftDown(copy, n, 0);
+    }
+    delete [] copy;
+}
+
+//----------------------------------------------------------------------
+// Heap<T>::SanityCheck
+//	Test whether the heap property still holds.
+//----------------------------------------------------------------------
+
+template <class T>
+void
+Heap<T>::SanityCheck() const
+{
+    ASSERT(0 <= numInHeap && numInHeap <= capacity);
+    for (int i = 1; i < numInHeap; i++)
+	ASSERT(!Before(elements[i], elements[(i - 1) / 2]));
+}
+
+//----------------------------------------------------------------------
+// Heap<T>::SelfTest
+//	Test whether this module is working.  Every item is put in
+//	twice, so the heap also has to cope with equal items.
+//----------------------------------------------------------------------
+
+template <class T>
+void
+Heap<T>::SelfTest(T *p, int numEntries)
+{
+    int i;
+    T *q = new T[2 * numEntries];
+
+    ASSERT(IsEmpty());
+    for (i = 0; i < numEntries; i++) {
+	Insert(p[i]);
+	Insert(p[i]);
+	SanityCheck();
+    }
+    ASSERT(NumInHeap() == 2 * numEntries);
+
+    // should be able to get out everything we put in, in order
+    for (i = 0; i < 2 * numEntries; i++) {
+	q[i] = RemoveFront();
+	SanityCheck();
+    }
+    ASSERT(IsEmpty());
+    for (i = 0; i < 2 * numEntries - 1; i++) {
+	ASSERT(compare(q[i], q[i + 1]) <= 0);
+    }
+
+    delete [] q;
+}
@@ -0,0 +1,70 @@
+// heap.h
+//	Data structures to manage a priority queue, kept as a binary
+//	min-heap in an array.
+//
+//	A Heap supports the same operations as a SortedList used as a
+//	queue -- Insert, Front, RemoveFront -- but insertion and removal
+//	take O(log n) time instead of O(n), and the items are stored by
+//	value in one array that only grows, so a heap that has reached
+//	its working size never allocates memory again.
+//
+//	Items that compare equal come out in the order they were put
+//	in, just as with a SortedList.  (Each item is tagged with a
+//	sequence number when it is inserted, and ties are broken on it.)
+//
+//	The type T must be copyable and have a default constructor.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef HEAP_H
+#define HEAP_H
+
+#include "copyright.h"
+#include "debug.h"
+
+template <class T>
+class Heap {
+  public:
+    Heap(int (*comp)(T x, T y));	// initialize an empty heap
+    ~Heap();				// de-allocate the heap
+
+    void Insert(T item);		// put an item in the heap
+    T Front();				// return the smallest item,
+					// without removing it
+    T RemoveFront();			// remove and return the smallest item
+
+    bool IsEmpty() { return numInHeap == 0; }
+    int NumInHeap() { return numInHeap; }
+
+    void Apply(void (*f)(T)) const;	// apply function to all elements,
+					// smallest first
+
+    void SanityCheck() const;		// is the heap property intact?
+    void SelfTest(T *p, int numEntries);
+					// verify module is working
+
+  private:
+    class HeapElement {
+      public:
+	T item;
+	unsigned int seq;		// when the item was inserted
+    };
+
+    HeapElement *elements;		// elements[0] is the smallest
+    int numInHeap;			// number of items in the heap
+    int capacity;			// size of "elements"
+    unsigned int nextSeq;		// sequence number for the next Insert
+    int (*compare)(T x, T y);		// function for ordering items
+
+    bool Before(const HeapElement &x, const HeapElement &y) const;
+    void SiftUp(HeapElement *a, int i) const;
+    void SiftDown(HeapElement *a, int n, int i) const;
+					// restore the heap property in "a"
+};
+
+#include "heap.cc"		// templates are really like macros
+				// so needs to be included in every
+				// file that uses the template
+#endif // HEAP_H
@@ -1,6 +1,7 @@
 // libtest.cc 
 //	Driver code to call self-test routines for standard library
-//	classes -- bitmaps, lists, sorted lists, and hash tables.
+//	classes -- bitmaps, lists, sorted lists, heaps, deques, and hash
+//	tables.
 //
 // Copyright (c) 1992-1996 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -11,12 +12,14 @@
 #include "bitmap.h"
 #include "list.h"
 #include "hash.h"
+#include "heap.h"
+#include "deque.h"
 #include "sysdep.h"
 
 //----------------------------------------------------------------------
 // IntCompare
 //	Compare two integers together.  Serves as the comparison
-//	function for testing SortedLists
+//	function for testing SortedLists and Heaps
 //----------------------------------------------------------------------
 
 static int 
@@ -26,6 +29,45 @@ IntCompare(int x, int y) {
     else return 1;
 }
 
+//----------------------------------------------------------------------
+// ThousandsCompare
+//	Compare two integers on their thousands only, so that integers
+//	can compare equal and still be told apart.  Used to test that a
+//	Heap keeps items with equal keys in the order they were put in.
+//----------------------------------------------------------------------
+
+static int 
+ThousandsCompare(int x, int y) {
+    return IntCompare(x / 1000, y / 1000);
+}
+
+//----------------------------------------------------------------------
+// HeapStableTest
+//	Put items with only a few distinct keys into a Heap, each one
+//	carrying its insertion order below its key (key * 1000 + order),
+//	and check that they come out sorted on the key and, among equal
+//	keys, in the order they went in -- that is, that every item is
+//	larger than the one before.
+//----------------------------------------------------------------------
+
+static void
+HeapStableTest() {
+    const int numItems = 100;
+    Heap<int> *heap = new Heap<int>(ThousandsCompare);
+    int i, last, item;
+
+    for (i = 0; i < numItems; i++)
+	heap->Insert(((i * 7) % 5) * 1000 + i);
+    last = -1;
+    for (i = 0; i < numItems; i++) {
+	item = heap->RemoveFront();
+	ASSERT(item > last);
+	last = item;
+    }
+    ASSERT(heap->IsEmpty());
+    delete heap;
+}
+
 //----------------------------------------------------------------------
 // HashInt, HashKey
 //	Compute a hash function on an integer.  Serves as the
@@ -50,7 +92,7 @@ HashKey(char *str) {
     return atoi(str);
 }
 
-// Array of values to be inserted into a List or SortedList. 
+// Array of values to be inserted into a List, SortedList or Heap. 
 static int listTestVector[] = { 9, 5, 7 };
 
 // Array of values to be inserted into the HashTable
@@ -60,8 +102,8 @@ static char *hashTestVector[] = { "0", "1", "2", "3", "4", "5", "6",
 
 //----------------------------------------------------------------------
 // LibSelfTest
-//	Run self tests on bitmaps, lists, sorted lists, and 
-//	hash tables.
+//	Run self tests on bitmaps, lists, sorted lists, heaps, deques,
+//	and hash tables.
 //----------------------------------------------------------------------
 
 void
@@ -69,6 +111,8 @@ LibSelfTest () {
     BitMap *map = new BitMap(200);
     List<int> *list = new List<int>;
     SortedList<int> *sortList = new SortedList<int>(IntCompare);
+    Heap<int> *heap = new Heap<int>(IntCompare);
+    Deque<int> *deque = new Deque<int>;
     HashTable<int, char *> *hashTable = 
 	new HashTable<int, char *>(HashKey, HashInt);
 	
@@ -76,10 +120,15 @@ LibSelfTest () {
     map->SelfTest();
     list->SelfTest(listTestVector, sizeof(listTestVector)/sizeof(int));
     sortList->SelfTest(listTestVector, sizeof(listTestVector)/sizeof(int));
+    heap->SelfTest(listTestVector, sizeof(listTestVector)/sizeof(int));
+    HeapStableTest();
+    deque->SelfTest(listTestVector, sizeof(listTestVector)/sizeof(int));
     hashTable->SelfTest(hashTestVector, sizeof(hashTestVector)/sizeof(char *));
 
     delete map;
     delete list;
     delete sortList;
+    delete heap;
+    delete deque;
     delete hashTable;
 }
@@ -32,6 +32,8 @@
 #include "sys/file.h"
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <poll.h>
+#include <sys/mman.h>
 
 #ifdef LINUX	 // at this point, linux doesn't support mprotect 
 #define NO_MPROT     
@@ -205,6 +207,84 @@ DeallocBoundedArray(char *ptr, int size)
 #endif
 }
 
+//----------------------------------------------------------------------
+// AllocLazyArray
+// 	Return an array of "size" bytes, with an inaccessible page just
+//	before and after it, as AllocBoundedArray does; but the memory is
+//	only reserved, not committed, so a page costs nothing until it is
+//	first touched, and reads as zeros until it is written.  The array
+//	starts on a page boundary.
+//
+//	"size" -- amount of useful space needed (in bytes)
+//----------------------------------------------------------------------
+
+char *
+AllocLazyArray(int size)
+{
+    int pgSize = getpagesize();
+    int length = divRoundUp(size, pgSize) * pgSize + 2 * pgSize;
+    char *base;
+
+    base = (char *) mmap(NULL, length, PROT_READ | PROT_WRITE, 
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    ASSERT(base != (char *) MAP_FAILED);
+    mprotect(base, pgSize, PROT_NONE);
+    mprotect(base + length - pgSize, pgSize, PROT_NONE);
+    return base + pgSize;
+}
+
+//----------------------------------------------------------------------
+// DeallocLazyArray
+// 	Give an array from AllocLazyArray, and its boundary pages, back
+//	to the host.
+//
+//	"ptr" -- the array to be deallocated
+//	"size" -- amount of useful space in the array (in bytes)
+//----------------------------------------------------------------------
+
+void
+DeallocLazyArray(char *ptr, int size)
+{
+    int pgSize = getpagesize();
+
+    munmap(ptr - pgSize, divRoundUp(size, pgSize) * pgSize + 2 * pgSize);
+}
+
+//----------------------------------------------------------------------
+// AllocExecutableArray
+// 	Return an array like AllocLazyArray's, whose contents the host
+//	can also execute: for machine code generated while we run.
+//
+//	"size" -- amount of useful space needed (in bytes)
+//----------------------------------------------------------------------
+
+char *
+AllocExecutableArray(int size)
+{
+    char *ptr = AllocLazyArray(size);
+    int pgSize = getpagesize();
+    int result;
+
+    result = mprotect(ptr, divRoundUp(size, pgSize) * pgSize, 
+			PROT_READ | PROT_WRITE | PROT_EXEC);
+    ASSERT(result == 0);
+    return ptr;
+}
+
+//----------------------------------------------------------------------
+// DeallocExecutableArray
+// 	Give an array from AllocExecutableArray back to the host.
+//
+//	"ptr" -- the array to be deallocated
+//	"size" -- amount of useful space in the array (in bytes)
+//----------------------------------------------------------------------
+
+void
+DeallocExecutableArray(char *ptr, int size)
+{
+    DeallocLazyArray(ptr, size);
+}
+
 //----------------------------------------------------------------------
 // PollFile
 // 	Check open file or open socket to see if there are any 
@@ -237,6 +317,49 @@ PollFile(int fd)
     return TRUE;
 }
 
+//----------------------------------------------------------------------
+// WaitForInput
+// 	Check a set of open files or sockets to see if any of them has
+//	characters that can be read.  If "block" is TRUE and none does,
+//	wait until one does.  Used to wait for console and network input
+//	without polling.
+//
+//	Uses poll() rather than select(), so descriptors aren't limited
+//	to 32, and regular files (always readable) work too.
+//
+//	"fds" -- the file descriptors to check
+//	"numFds" -- how many there are
+//	"block" -- wait if nothing can be read yet
+//
+// Returns:
+//	the index in "fds" of a readable descriptor, or -1 if none is
+//----------------------------------------------------------------------
+
+int
+WaitForInput(int *fds, int numFds, bool block)
+{
+    const int MaxFds = 16;
+    struct pollfd pfds[MaxFds];
+    int retVal;
+
+    ASSERT(numFds <= MaxFds);
+    for (int i = 0; i < numFds; i++) {
+	pfds[i].fd = fds[i];
+	pfds[i].events = POLLIN;
+	pfds[i].revents = 0;
+    }
+    do {
+	retVal = poll(pfds, numFds, block ? -1 : 0);
+    } while (retVal < 0 && errno == EINTR);	// interrupted by a signal
+    ASSERT(retVal >= 0);
+
+    for (int i = 0; i < numFds; i++) {
+	if (pfds[i].revents & (POLLIN | POLLHUP | POLLERR))
+	    return i;
+    }
+    return -1;
+}
+
 //----------------------------------------------------------------------
 // OpenForWrite
 // 	Open a file for writing.  Create it if it doesn't exist; truncate it 
@@ -35,10 +35,24 @@ extern unsigned int RandomNumber();
 extern char *AllocBoundedArray(int size);
 extern void DeallocBoundedArray(char *p, int size);
 
+// Same, but only reserve the memory: a page is allocated (and reads
+// as zeros until written) the first time it is touched
+extern char *AllocLazyArray(int size);
+extern void DeallocLazyArray(char *p, int size);
+
+// Same again, but the host may also run the contents as machine code
+extern char *AllocExecutableArray(int size);
+extern void DeallocExecutableArray(char *p, int size);
+
 // Check file to see if there are any characters to be read.
 // If no characters in the file, return without waiting.
 extern bool PollFile(int fd);
 
+// Check several files (or sockets) at once, waiting until one of them
+// has characters to be read if "block" is TRUE.  Returns the index
+// in "fds" of one that is readable, or -1 if none is.
+extern int WaitForInput(int *fds, int numFds, bool block);
+
 // File operations: open/read/write/lseek/close, and check for error
 // For simulating the disk and the console devices.
 extern int OpenForWrite(char *name);
@@ -0,0 +1,1002 @@
+// blockcompiler.cc
+//	Routines to translate basic blocks of user code into i386 code.
+//	See blockcompiler.h for the overall design.
+//
+//	The code for a block of n instructions looks like this:
+//
+//		push ebx; push esi
+//		mov ebx, &registers[32]
+//		mov eax, first
+//		jmp [table + eax * 4]
+//	table:	entry 0, entry 1, ... entry n - 1
+//	entry i:
+//		cmp [quietTicks], 0	(for an instruction we run)
+//		jg body i
+//	fallback i:
+//		mov eax, i; pop esi; pop ebx; ret
+//	body i:
+//		instruction i; jumps to fallback i if it can't complete
+//		delayed load, PC update, tick
+//		...
+//		mov eax, n; pop esi; pop ebx; ret
+//
+//	EBX points 32 registers into Machine::registers, so that every
+//	register, up to BadVAddrReg, is a one byte displacement away.
+//	EAX, ECX, EDX and ESI are scratch; ESI carries the PC to use
+//	after the delay slot out of a branch.
+//
+//	Nothing is cached in host registers between instructions, so
+//	whatever instruction we stop at, Machine::registers is up to date.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "blockcompiler.h"
+#include "mipssim.h"
+#include "debug.h"
+#include "main.h"
+
+// Host registers, as the i386 numbers them
+enum { EAX = 0, ECX = 1, EDX = 2, EBX = 3, ESP = 4, EBP = 5, ESI = 6 };
+
+// Condition codes for Jcc and SETcc; Always makes Jump a plain JMP
+enum { CondO = 0x0, CondB = 0x2, CondE = 0x4, CondNE = 0x5,
+       CondL = 0xc, CondGE = 0xd, CondLE = 0xe, CondG = 0xf, Always = -1 };
+
+// The "/digit" of each group 1 arithmetic instruction; "op * 8 + 3" is
+// the form with a register destination and a memory source
+enum { AluAdd = 0, AluOr = 1, AluAnd = 4, AluSub = 5, AluXor = 6, AluCmp = 7 };
+
+// The "/digit" of each shift
+enum { ShiftLeft = 4, ShiftLogical = 5, ShiftArith = 7 };
+
+const int RegBias = 128;	// EBX is this many bytes into registers
+const int PrologueSize = 20;	// bytes before the entry table
+const int MaxInstrSize = 192;	// most bytes one instruction can take
+
+//----------------------------------------------------------------------
+// ModRM, AddressOf
+// 	Helpers for encoding: a ModR/M byte, and a host pointer as a
+//	32-bit operand.
+//----------------------------------------------------------------------
+
+static int
+ModRM(int mod, int reg, int rm)
+{
+    return (mod << 6) | (reg << 3) | rm;
+}
+
+static int
+AddressOf(void *pointer)
+{
+    return (int) (long) pointer;
+}
+
+//----------------------------------------------------------------------
+// IsLoad
+// 	Does an opCode leave a delayed load for the next instruction?
+//----------------------------------------------------------------------
+
+static bool
+IsLoad(int opCode)
+{
+    switch (opCode) {
+      case OP_LB: case OP_LBU: case OP_LH: case OP_LHU:
+      case OP_LW: case OP_LWL: case OP_LWR:
+	return TRUE;
+      default:
+	return FALSE;
+    }
+}
+
+//----------------------------------------------------------------------
+// BlockCompiler::BlockCompiler
+// 	Initialize a compiler for blocks that run on machine "m".  The
+//	code refers to the machine's registers, translation cache and
+//	tick batch by their addresses, so it only works for "m".
+//----------------------------------------------------------------------
+
+BlockCompiler::BlockCompiler(Machine *m)
+{
+    ASSERT(sizeof(TransCacheEntry) <= 127 && sizeof(Instruction) <= 127);
+
+    machine = m;
+    for (pageShift = 0; (1U << pageShift) < PageSize; pageShift++)
+	;
+    ASSERT((1U << pageShift) == PageSize);
+    out = NULL;
+}
+
+//----------------------------------------------------------------------
+// BlockCompiler::MaxCodeSize
+// 	Return the most bytes Compile may use for a block of "length"
+//	instructions, so the caller can find room before compiling.
+//----------------------------------------------------------------------
+
+int
+BlockCompiler::MaxCodeSize(int length)
+{
+    return PrologueSize + length * (4 + MaxInstrSize) + MaxInstrSize;
+}
+
+//----------------------------------------------------------------------
+// BlockCompiler::IsNative
+// 	Return TRUE if we translate instructions with this opCode, FALSE
+//	if the generated code always leaves them to the interpreter.
+//	Loads and stores can only be translated when they can go through
+//	the translation cache without telling anyone.
+//----------------------------------------------------------------------
+
+bool
+BlockCompiler::IsNative(int opCode)
+{
+    switch (opCode) {
+      case OP_ADD: case OP_ADDI: case OP_ADDIU: case OP_ADDU:
+      case OP_AND: case OP_ANDI: case OP_LUI: case OP_NOR:
+      case OP_OR: case OP_ORI: case OP_XOR: case OP_XORI:
+      case OP_SLL: case OP_SLLV: case OP_SRA: case OP_SRAV:
+      case OP_SRL: case OP_SRLV: case OP_SLT: case OP_SLTI:
+      case OP_SLTIU: case OP_SLTU: case OP_SUB: case OP_SUBU:
+      case OP_MFHI: case OP_MFLO: case OP_MTHI: case OP_MTLO:
+      case OP_MULT: case OP_MULTU:
+      case OP_BEQ: case OP_BNE: case OP_BGEZ: case OP_BGEZAL:
+      case OP_BGTZ: case OP_BLEZ: case OP_BLTZ: case OP_BLTZAL:
+      case OP_J: case OP_JAL: case OP_JR: case OP_JALR:
+	return TRUE;
+
+      case OP_LB: case OP_LBU: case OP_LH: case OP_LHU: case OP_LW:
+      case OP_SB: case OP_SH: case OP_SW:
+	return machine->useTransCache && !machine->touchOnHit;
+
+      default:
+	return FALSE;
+    }
+}
+
+//----------------------------------------------------------------------
+// BlockCompiler::Compile
+// 	Translate the "length" instructions at "instrs" into code at
+//	"code", laid out as described at the top of this file.  "code"
+//	must have room for MaxCodeSize(length) bytes.  Returns how many
+//	it used.
+//
+//	Whether the previous instruction left a delayed load is known
+//	here for every instruction but the first (whose predecessor may
+//	have been anywhere), so we only emit the delayed load where
+//	there may be one.
+//----------------------------------------------------------------------
+
+int
+BlockCompiler::Compile(Instruction *instrs, int length, char *code)
+{
+    int *table;
+    char *start, *fallback, *skip;
+    bool loadPending = TRUE;
+
+    out = code;
+    Byte(0x53);					// push ebx
+    Byte(0x56);					// push esi
+    Byte(0xb8 + EBX);				// mov ebx, registers + 32
+    Address(&machine->registers[RegBias / 4]);
+    Byte(0x8b); Byte(0x44); Byte(0x24); Byte(0x0c);	// mov eax, [esp + 12]
+    Byte(0xff); Byte(0x24); Byte(0x85);		// jmp [table + eax * 4]
+    table = (int *) (code + PrologueSize);
+    Address(table);
+    while (out < (char *) table)
+	Byte(0xcc);				// int3; never reached
+    out = (char *) (table + length);
+
+    for (int i = 0; i < length; i++) {
+	start = out;
+	table[i] = AddressOf(out);
+	if (IsNative(instrs[i].opCode)) {
+	    Byte(0x83); Byte(ModRM(0, AluCmp, 5));	// cmp [quietTicks], 0
+	    Address(&machine->quietTicks);
+	    Byte(0);
+	    skip = JumpForward(CondG);
+	    fallback = out;
+	    Exit(i);
+	    Land(skip);
+	    Translate(&instrs[i], loadPending, fallback);
+	} else
+	    Exit(i);
+	loadPending = IsLoad(instrs[i].opCode);
+	ASSERT(out - start <= MaxInstrSize);
+    }
+    Exit(length);
+    return out - code;
+}
+
+//----------------------------------------------------------------------
+// BlockCompiler::Translate
+// 	Emit the code for one instruction, which IsNative accepted.
+//	The code must compute everything that can fail -- overflow, a
+//	miss in the translation cache -- before it changes any state, so
+//	that it can jump to "fallback" and leave the whole instruction
+//	to the interpreter.
+//
+//	Each case does what Machine::ExecuteOp does for the opCode, down
+//	to the order in which registers are read and written (which
+//	matters when one register is both source and destination).
+//	Writes to register 0 are dropped, since ExecuteOp's are undone by
+//	DelayedLoad before anyone can see them.
+//
+//	"loadPending" -- the previous instruction may have left a
+//		delayed load
+//	"fallback" -- the code that returns this instruction's index
+//----------------------------------------------------------------------
+
+void
+BlockCompiler::Translate(Instruction *instr, bool loadPending, char *fallback)
+{
+    int op = instr->opCode;
+    int rs = instr->rs, rt = instr->rt, rd = instr->rd;
+    int extra = instr->extra;
+    int loadReg = -1, size;
+    bool branch = FALSE;
+    char *skip;
+
+    switch (op) {
+      case OP_ADD: case OP_ADDU: case OP_SUB: case OP_SUBU:
+      case OP_AND: case OP_XOR: case OP_NOR:
+	Get(EAX, rs);
+	if (op == OP_ADD || op == OP_ADDU)
+	    Alu(AluAdd, EAX, rt);
+	else if (op == OP_SUB || op == OP_SUBU)
+	    Alu(AluSub, EAX, rt);
+	else if (op == OP_AND)
+	    Alu(AluAnd, EAX, rt);
+	else if (op == OP_XOR)
+	    Alu(AluXor, EAX, rt);
+	else {
+	    Alu(AluOr, EAX, rt);
+	    Byte(0xf7); Byte(ModRM(3, 2, EAX));	// not eax
+	}
+	if (op == OP_ADD || op == OP_SUB)
+	    Jump(CondO, fallback);
+	if (rd != 0)
+	    Put(rd, EAX);
+	break;
+
+      case OP_OR:			// ExecuteOp ORs rs with itself
+	Get(EAX, rs);
+	if (rd != 0)
+	    Put(rd, EAX);
+	break;
+
+      case OP_ADDI: case OP_ADDIU:
+	Get(EAX, rs);
+	AluImm(AluAdd, EAX, extra);
+	if (op == OP_ADDI)
+	    Jump(CondO, fallback);
+	if (rt != 0)
+	    Put(rt, EAX);
+	break;
+
+      case OP_ANDI: case OP_ORI: case OP_XORI:
+	Get(EAX, rs);
+	AluImm(op == OP_ANDI ? AluAnd : (op == OP_ORI ? AluOr : AluXor),
+			EAX, extra & 0xffff);
+	if (rt != 0)
+	    Put(rt, EAX);
+	break;
+
+      case OP_LUI:
+	if (rt != 0)
+	    PutImm(rt, (int) ((unsigned) extra << 16));
+	break;
+
+      case OP_SLT: case OP_SLTU:
+	Get(EAX, rs);
+	Alu(AluCmp, EAX, rt);
+	SetIf(op == OP_SLT ? CondL : CondB, EAX);
+	if (rd != 0)
+	    Put(rd, EAX);
+	break;
+
+      case OP_SLTI: case OP_SLTIU:
+	Get(EAX, rs);
+	AluImm(AluCmp, EAX, extra);
+	SetIf(op == OP_SLTI ? CondL : CondB, EAX);
+	if (rt != 0)
+	    Put(rt, EAX);
+	break;
+
+      case OP_SLL: case OP_SRA: case OP_SRL:	// SRL is arithmetic too,
+	Get(EAX, rt);				// as in ExecuteOp
+	if (extra != 0)
+	    Shift(op == OP_SLL ? ShiftLeft : ShiftArith, EAX, extra);
+	if (rd != 0)
+	    Put(rd, EAX);
+	break;
+
+      case OP_SLLV: case OP_SRAV: case OP_SRLV:
+	Get(ECX, rs);				// the host masks the count
+	Get(EAX, rt);				// to 5 bits, as we must
+	Shift(op == OP_SLLV ? ShiftLeft : ShiftArith, EAX, -1);
+	if (rd != 0)
+	    Put(rd, EAX);
+	break;
+
+      case OP_MFHI: case OP_MFLO:
+	Get(EAX, op == OP_MFHI ? HiReg : LoReg);
+	if (rd != 0)
+	    Put(rd, EAX);
+	break;
+
+      case OP_MTHI: case OP_MTLO:
+	Get(EAX, rs);
+	Put(op == OP_MTHI ? HiReg : LoReg, EAX);
+	break;
+
+      case OP_MULT: case OP_MULTU:
+	Get(EAX, rs);
+	Byte(0xf7);				// imul or mul [rt]
+	Byte(ModRM(1, op == OP_MULT ? 5 : 4, EBX));
+	Byte(rt * 4 - RegBias);
+	Put(LoReg, EAX);
+	Put(HiReg, EDX);
+	break;
+
+      case OP_BEQ: case OP_BNE:
+	Get(ESI, NextPCReg);
+	AluImm(AluAdd, ESI, 4);
+	Get(EAX, rs);
+	Alu(AluCmp, EAX, rt);
+	skip = JumpForward(op == OP_BEQ ? CondNE : CondE);
+	AluImm(AluAdd, ESI, IndexToAddr(extra) - 4);
+	Land(skip);
+	branch = TRUE;
+	break;
+
+      case OP_BGEZAL: case OP_BLTZAL:
+	Get(EAX, NextPCReg);
+	AluImm(AluAdd, EAX, 4);
+	Put(R31, EAX);
+	// fall through
+      case OP_BGEZ: case OP_BGTZ: case OP_BLEZ: case OP_BLTZ:
+	Get(ESI, NextPCReg);
+	AluImm(AluAdd, ESI, 4);
+	Byte(0x83); Byte(ModRM(1, AluCmp, EBX));	// cmp [rs], 0
+	Byte(rs * 4 - RegBias);
+	Byte(0);
+	if (op == OP_BGEZ || op == OP_BGEZAL)
+	    skip = JumpForward(CondL);
+	else if (op == OP_BLTZ || op == OP_BLTZAL)
+	    skip = JumpForward(CondGE);
+	else if (op == OP_BGTZ)
+	    skip = JumpForward(CondLE);
+	else
+	    skip = JumpForward(CondG);
+	AluImm(AluAdd, ESI, IndexToAddr(extra) - 4);
+	Land(skip);
+	branch = TRUE;
+	break;
+
+      case OP_J: case OP_JAL:
+	if (op == OP_JAL) {
+	    Get(EAX, NextPCReg);
+	    AluImm(AluAdd, EAX, 4);
+	    Put(R31, EAX);
+	}
+	Get(ESI, NextPCReg);
+	AluImm(AluAdd, ESI, 4);
+	AluImm(AluAnd, ESI, 0xf0000000);
+	AluImm(AluOr, ESI, IndexToAddr(extra));
+	branch = TRUE;
+	break;
+
+      case OP_JR:
+	Get(ESI, rs);
+	branch = TRUE;
+	break;
+
+      case OP_JALR:
+	Get(EAX, NextPCReg);
+	AluImm(AluAdd, EAX, 4);
+	if (rd != 0)
+	    Put(rd, EAX);
+	if (rd == rs) {				// jumps to where it links to
+	    Byte(0x89); Byte(ModRM(3, EAX, ESI));	// mov esi, eax
+	} else
+	    Get(ESI, rs);
+	branch = TRUE;
+	break;
+
+      case OP_LB: case OP_LBU: case OP_LH: case OP_LHU: case OP_LW:
+	size = (op == OP_LW) ? 4 : ((op == OP_LH || op == OP_LHU) ? 2 : 1);
+	Get(EAX, rs);
+	if (extra != 0)
+	    AluImm(AluAdd, EAX, extra);
+	Lookup(FALSE, size, fallback);
+	if (op == OP_LW)
+	    Byte(0x8b);				// mov eax, [esi + eax]
+	else {
+	    Byte(0x0f);				// movsx or movzx
+	    if (op == OP_LB)
+		Byte(0xbe);
+	    else if (op == OP_LBU)
+		Byte(0xb6);
+	    else if (op == OP_LH)
+		Byte(0xbf);
+	    else
+		Byte(0xb7);
+	}
+	Byte(ModRM(0, EAX, 4)); Byte(ModRM(0, EAX, ESI));
+	loadReg = rt;
+	break;
+
+      case OP_SB: case OP_SH: case OP_SW:
+	size = (op == OP_SW) ? 4 : ((op == OP_SH) ? 2 : 1);
+	Get(EAX, rs);
+	if (extra != 0)
+	    AluImm(AluAdd, EAX, extra);
+	Lookup(TRUE, size, fallback);
+	Byte(0x01); Byte(ModRM(3, EAX, ESI));	// add esi, eax
+
+	// fall back if the word was decoded, so WriteMem can forget it
+	Byte(0x89); Byte(ModRM(3, ESI, EDX));	// mov edx, esi
+	AluImm(AluSub, EDX, AddressOf(machine->mainMemory));
+	Shift(ShiftLogical, EDX, 2);
+	Byte(0x6b); Byte(ModRM(3, EDX, EDX));	// imul edx, edx,
+	Byte(sizeof(Instruction));		//	sizeof(Instruction)
+	Byte(0x80); Byte(ModRM(2, AluCmp, EDX));	// cmp decodeCache[edx]
+	Address(&machine->decodeCache[0].opCode);	//	.opCode, 0
+	Byte(0);
+	Jump(CondNE, fallback);
+
+	Get(ECX, rt);
+	if (size == 2)
+	    Byte(0x66);				// operand size prefix
+	Byte(size == 1 ? 0x88 : 0x89);		// mov [esi], ecx
+	Byte(ModRM(0, ECX, ESI));
+	break;
+
+      default:
+	ASSERT(FALSE);
+    }
+    Retire(loadPending, loadReg, branch);
+}
+
+//----------------------------------------------------------------------
+// BlockCompiler::Lookup
+// 	Emit a lookup of the virtual address in EAX in the translation
+//	cache, as Machine::CachedTranslation does.  On a hit, leaves the
+//	page in mainMemory in ESI and the offset into it in EAX; on a
+//	miss, or if the address isn't aligned, jumps to "fallback".
+//
+//	"writing" -- look for a slot that may be written through
+//	"size" -- bytes being accessed
+//----------------------------------------------------------------------
+
+void
+BlockCompiler::Lookup(bool writing, int size, char *fallback)
+{
+    TransCacheEntry *slots = machine->transCache;
+
+    if (size > 1) {
+	Byte(0xa8); Byte(size - 1);		// test al, size - 1
+	Jump(CondNE, fallback);
+    }
+    Byte(0x89); Byte(ModRM(3, EAX, EDX));	// mov edx, eax
+    Shift(ShiftLogical, EDX, pageShift);	// edx = vpn
+    Byte(0x89); Byte(ModRM(3, EDX, ECX));	// mov ecx, edx
+    AluImm(AluAnd, ECX, TransCacheSize - 1);
+    Byte(0x6b); Byte(ModRM(3, ECX, ECX));	// imul ecx, ecx,
+    Byte(sizeof(TransCacheEntry));		//	sizeof(TransCacheEntry)
+
+    Byte(0x8b); Byte(ModRM(2, ESI, ECX));	// mov esi, slot base
+    Address(writing ? &slots[0].writeBase : &slots[0].readBase);
+    Byte(0x85); Byte(ModRM(3, ESI, ESI));	// test esi, esi
+    Jump(CondE, fallback);
+    Byte(0x3b); Byte(ModRM(2, EDX, ECX));	// cmp edx, slot vpn
+    Address(&slots[0].vpn);
+    Jump(CondNE, fallback);
+    Byte(0x8b); Byte(ModRM(0, EDX, 5));	// mov edx, [pageTable]
+    Address(&machine->pageTable);
+    Byte(0x3b); Byte(ModRM(2, EDX, ECX));	// cmp edx, slot pageTable
+    Address(&slots[0].pageTable);
+    Jump(CondNE, fallback);
+    AluImm(AluAnd, EAX, PageSize - 1);
+}
+
+//----------------------------------------------------------------------
+// BlockCompiler::Retire
+// 	Emit what BlockEngine::Step does once an instruction has
+//	completed: the delayed load, the PC update, and the tick.
+//
+//	"loadPending" -- the previous instruction may have left a load
+//	"loadReg" -- if not -1, this instruction is a load into that
+//		register, of the value now in EAX
+//	"branch" -- the PC after the delay slot is in ESI, not NextPC + 4
+//----------------------------------------------------------------------
+
+void
+BlockCompiler::Retire(bool loadPending, int loadReg, bool branch)
+{
+    if (loadPending) {			// registers[LoadReg] = LoadValue
+	Get(ECX, LoadReg);
+	Get(EDX, LoadValueReg);
+	Byte(0x89); Byte(ModRM(1, EDX, 4));	// mov [ebx + ecx * 4 - 128],
+	Byte(ModRM(2, ECX, EBX)); Byte(-RegBias);	//	edx
+    }
+    if (loadReg >= 0) {
+	PutImm(LoadReg, loadReg);
+	Put(LoadValueReg, EAX);
+    } else if (loadPending) {
+	PutImm(LoadReg, 0);
+	PutImm(LoadValueReg, 0);
+    }
+    if (loadPending)
+	PutImm(0, 0);
+
+    Get(ECX, PCReg);
+    Put(PrevPCReg, ECX);
+    Get(ECX, NextPCReg);
+    Put(PCReg, ECX);
+    if (branch)
+	Put(NextPCReg, ESI);
+    else {
+	AluImm(AluAdd, ECX, 4);
+	Put(NextPCReg, ECX);
+    }
+
+    Byte(0xff); Byte(ModRM(0, 1, 5));		// dec [quietTicks]
+    Address(&machine->quietTicks);
+    Byte(0xff); Byte(ModRM(0, 0, 5));		// inc [batchedTicks]
+    Address(&machine->batchedTicks);
+}
+
+//----------------------------------------------------------------------
+// BlockCompiler::Exit
+// 	Emit a return from the block's code with "index" as the result.
+//----------------------------------------------------------------------
+
+void
+BlockCompiler::Exit(int index)
+{
+    Byte(0xb8 + EAX);				// mov eax, index
+    Word(index);
+    Byte(0x5e);					// pop esi
+    Byte(0x5b);					// pop ebx
+    Byte(0xc3);					// ret
+}
+
+//----------------------------------------------------------------------
+// BlockCompiler::Byte, Word, Address
+// 	Emit a byte, a 32-bit value, or a host address.
+//----------------------------------------------------------------------
+
+void
+BlockCompiler::Byte(int value)
+{
+    *out++ = (char) value;
+}
+
+void
+BlockCompiler::Word(int value)
+{
+    for (int i = 0; i < 4; i++)
+	Byte(value >> (8 * i));
+}
+
+void
+BlockCompiler::Address(void *pointer)
+{
+    Word(AddressOf(pointer));
+}
+
+//----------------------------------------------------------------------
+// BlockCompiler::Get, Put, PutImm
+// 	Emit a move of simulated register "reg" into host register
+//	"hostReg", of "hostReg" into "reg", or of a constant into "reg".
+//----------------------------------------------------------------------
+
+void
+BlockCompiler::Get(int hostReg, int reg)
+{
+    Byte(0x8b); Byte(ModRM(1, hostReg, EBX)); Byte(reg * 4 - RegBias);
+}
+
+void
+BlockCompiler::Put(int reg, int hostReg)
+{
+    Byte(0x89); Byte(ModRM(1, hostReg, EBX)); Byte(reg * 4 - RegBias);
+}
+
+void
+BlockCompiler::PutImm(int reg, int value)
+{
+    Byte(0xc7); Byte(ModRM(1, 0, EBX)); Byte(reg * 4 - RegBias);
+    Word(value);
+}
+
+//----------------------------------------------------------------------
+// BlockCompiler::Alu, AluImm, Shift, SetIf
+// 	Emit arithmetic on host register "hostReg": "op" it with
+//	simulated register "reg", or with a constant; shift it by a
+//	constant "count", or by CL if "count" is -1; or set it to 1 if
+//	condition "cond" holds and 0 otherwise.
+//----------------------------------------------------------------------
+
+void
+BlockCompiler::Alu(int op, int hostReg, int reg)
+{
+    Byte(op * 8 + 3); Byte(ModRM(1, hostReg, EBX)); Byte(reg * 4 - RegBias);
+}
+
+void
+BlockCompiler::AluImm(int op, int hostReg, int value)
+{
+    if (value >= -128 && value <= 127) {
+	Byte(0x83); Byte(ModRM(3, op, hostReg)); Byte(value);
+    } else {
+	Byte(0x81); Byte(ModRM(3, op, hostReg)); Word(value);
+    }
+}
+
+void
+BlockCompiler::Shift(int op, int hostReg, int count)
+{
+    if (count < 0) {
+	Byte(0xd3); Byte(ModRM(3, op, hostReg));
+    } else {
+	Byte(0xc1); Byte(ModRM(3, op, hostReg)); Byte(count);
+    }
+}
+
+void
+BlockCompiler::SetIf(int cond, int hostReg)
+{
+    ASSERT(hostReg <= EBX);			// has a byte register
+    Byte(0x0f); Byte(0x90 + cond); Byte(ModRM(3, 0, hostReg));
+    Byte(0x0f); Byte(0xb6); Byte(ModRM(3, hostReg, hostReg));	// movzx
+}
+
+//----------------------------------------------------------------------
+// BlockCompiler::Jump
+// 	Emit a jump to "target", code we have already emitted, if
+//	condition "cond" holds (always, if "cond" is Always).
+//----------------------------------------------------------------------
+
+void
+BlockCompiler::Jump(int cond, char *target)
+{
+    int distance = target - (out + 2);
+
+    if (distance >= -128) {
+	Byte(cond == Always ? 0xeb : 0x70 + cond);
+	Byte(distance);
+    } else if (cond == Always) {
+	Byte(0xe9);
+	Word(target - (out + 4));
+    } else {
+	Byte(0x0f); Byte(0x80 + cond);
+	Word(target - (out + 4));
+    }
+}
+
+//----------------------------------------------------------------------
+// BlockCompiler::JumpForward, Land
+// 	Emit a short jump, if "cond" holds, to code we haven't emitted
+//	yet; Land makes it jump to where the next byte goes.
+//----------------------------------------------------------------------
+
+char *
+BlockCompiler::JumpForward(int cond)
+{
+    Byte(cond == Always ? 0xeb : 0x70 + cond);
+    Byte(0);
+    return out - 1;
+}
+
+void
+BlockCompiler::Land(char *jump)
+{
+    int distance = out - (jump + 1);
+
+    ASSERT(distance <= 127);
+    *jump = (char) distance;
+}
+
+//----------------------------------------------------------------------
+// RandomValue, RandomReg, RandomInstruction
+// 	Make up register contents, register numbers and instructions for
+//	BlockCompiler::SelfTest.  Values favor the edges of arithmetic
+//	(for overflow and the signed and unsigned compares), and virtual
+//	addresses close to the pages the test maps, a little either side
+//	of their alignment.  Only a few registers are used, so that the
+//	instructions in a block depend on each other.
+//----------------------------------------------------------------------
+
+static const int TestOps[] = {
+    OP_ADD, OP_ADDI, OP_ADDIU, OP_ADDU, OP_AND, OP_ANDI, OP_LUI, OP_NOR,
+    OP_OR, OP_ORI, OP_XOR, OP_XORI, OP_SLL, OP_SLLV, OP_SRA, OP_SRAV,
+    OP_SRL, OP_SRLV, OP_SLT, OP_SLTI, OP_SLTIU, OP_SLTU, OP_SUB, OP_SUBU,
+    OP_MFHI, OP_MFLO, OP_MTHI, OP_MTLO, OP_MULT, OP_MULTU,
+    OP_BEQ, OP_BNE, OP_BGEZ, OP_BGEZAL, OP_BGTZ, OP_BLEZ, OP_BLTZ,
+    OP_BLTZAL, OP_J, OP_JAL, OP_JR, OP_JALR,
+    OP_DIVU, OP_SYSCALL, OP_RES,			// always fall back
+    OP_LB, OP_LBU, OP_LH, OP_LHU, OP_LW, OP_SB, OP_SH, OP_SW	// last
+};
+static const int NumTestOps = sizeof(TestOps) / sizeof(TestOps[0]);
+static const int NumMemoryOps = 8;	// loads and stores, at the end
+
+static int
+RandomValue()
+{
+    switch (RandomNumber() % 8) {
+      case 0:
+	return 0;
+      case 1:
+	return -1;
+      case 2:
+	return (int) SIGN_BIT;
+      case 3:
+	return (int) ~SIGN_BIT;
+      case 4:
+	return (int) (RandomNumber() % 16) - 8;
+      case 5: case 6:
+	return (int) ((RandomNumber() % (2 * TransCacheSize)) * PageSize
+			+ RandomNumber() % PageSize - RandomNumber() % 4);
+      default:
+	return (int) RandomNumber();
+    }
+}
+
+static int
+RandomReg()
+{
+    return (RandomNumber() % 4 == 0) ? 0 : 1 + RandomNumber() % 7;
+}
+
+static void
+RandomInstruction(Instruction *instr, bool memoryOnly)
+{
+    if (memoryOnly)
+	instr->opCode = TestOps[NumTestOps - 1 - RandomNumber() % NumMemoryOps];
+    else
+	instr->opCode = TestOps[RandomNumber() % NumTestOps];
+    instr->rs = RandomReg();
+    instr->rt = RandomReg();
+    instr->rd = RandomReg();
+    switch (instr->opCode) {
+      case OP_SLL: case OP_SRA: case OP_SRL:
+	instr->extra = RandomNumber() % 32;
+	break;
+      case OP_J: case OP_JAL:
+	instr->extra = RandomNumber() & 0x3ffffff;
+	break;
+      case OP_ANDI: case OP_ORI: case OP_XORI: case OP_LUI:
+	instr->extra = (short) RandomNumber();
+	break;
+      default:
+	if (RandomNumber() % 3 == 0)
+	    instr->extra = 0;
+	else if (RandomNumber() % 2 == 0)
+	    instr->extra = (int) (RandomNumber() % 64) - 32;
+	else
+	    instr->extra = (short) RandomNumber();
+    }
+}
+
+//----------------------------------------------------------------------
+// BlockCompiler::Randomize
+// 	Give the shadow machine "m" random registers, memory and decode
+//	cache, and a random translation cache: slots for the wrong page
+//	or the wrong page table, slots that can only be read, empty
+//	slots.  Anything that misses goes to Translate, which fails,
+//	since the page table is empty.  "tables" are two page tables to
+//	choose from.
+//----------------------------------------------------------------------
+
+void
+BlockCompiler::Randomize(Machine *m, TranslationEntry *tables)
+{
+    TransCacheEntry *slot;
+
+    for (int i = 0; i < NumTotalRegs; i++)
+	m->registers[i] = RandomValue();
+    m->registers[0] = 0;
+    m->registers[LoadReg] = (RandomNumber() % 2) ? 0 : RandomNumber() % 32;
+    m->registers[LoadValueReg] = m->registers[LoadReg] ? RandomValue() : 0;
+    m->registers[PCReg] = (RandomNumber() % 1024) * 4;
+    m->registers[NextPCReg] = m->registers[PCReg] + 4;
+
+    for (int i = 0; i < MemorySize; i += 4)
+	*(unsigned int *) &m->mainMemory[i] = RandomNumber();
+    for (int i = 0; i < MemorySize / 4; i++)
+	m->decodeCache[i].opCode = 
+		(RandomNumber() % 16 == 0) ? 1 + RandomNumber() % MaxOpcode : 0;
+
+    m->pageTable = &tables[0];
+    m->pageTableSize = 0;
+    for (int i = 0; i < TransCacheSize; i++) {
+	slot = &m->transCache[i];
+	slot->vpn = i + ((RandomNumber() % 4 == 0) ? TransCacheSize : 0);
+	if (RandomNumber() % 8 == 0)
+	    slot->vpn++;
+	slot->pageTable = &tables[(RandomNumber() % 8 == 0) ? 1 : 0];
+	slot->entry = slot->pageTable;
+	if (RandomNumber() % 6 == 0)
+	    slot->readBase = NULL;
+	else
+	    slot->readBase = m->mainMemory 
+				+ (RandomNumber() % NumPhysPages) * PageSize;
+	slot->writeBase = (RandomNumber() % 3 == 0) ? NULL : slot->readBase;
+    }
+
+    m->quietTicks = RandomNumber() % 40;
+    m->batchedTicks = RandomNumber() % 10;
+    m->shadowStopped = FALSE;
+    for (unsigned int i = 0; i < NumPhysPages; i++)
+	m->codeWritten[i] = FALSE;
+}
+
+//----------------------------------------------------------------------
+// BlockCompiler::Copy, Same
+// 	Copy the state Randomize sets up from one shadow machine to
+//	another, or compare it.  Each machine has its own memory, so
+//	the translation cache's pointers into it are relative to that.
+//----------------------------------------------------------------------
+
+void
+BlockCompiler::Copy(Machine *from, Machine *to)
+{
+    TransCacheEntry *slot;
+
+    for (int i = 0; i < NumTotalRegs; i++)
+	to->registers[i] = from->registers[i];
+    for (int i = 0; i < MemorySize; i++)
+	to->mainMemory[i] = from->mainMemory[i];
+    for (int i = 0; i < MemorySize / 4; i++)
+	to->decodeCache[i].opCode = from->decodeCache[i].opCode;
+    to->pageTable = from->pageTable;
+    to->pageTableSize = from->pageTableSize;
+    for (int i = 0; i < TransCacheSize; i++) {
+	slot = &to->transCache[i];
+	*slot = from->transCache[i];
+	if (slot->readBase != NULL)
+	    slot->readBase += to->mainMemory - from->mainMemory;
+	if (slot->writeBase != NULL)
+	    slot->writeBase += to->mainMemory - from->mainMemory;
+    }
+    to->quietTicks = from->quietTicks;
+    to->batchedTicks = from->batchedTicks;
+    to->shadowStopped = from->shadowStopped;
+    for (unsigned int i = 0; i < NumPhysPages; i++)
+	to->codeWritten[i] = from->codeWritten[i];
+}
+
+bool
+BlockCompiler::Same(Machine *a, Machine *b)
+{
+    for (int i = 0; i < NumTotalRegs; i++) {
+	if (a->registers[i] != b->registers[i])
+	    return FALSE;
+    }
+    for (int i = 0; i < MemorySize; i++) {
+	if (a->mainMemory[i] != b->mainMemory[i])
+	    return FALSE;
+    }
+    for (int i = 0; i < MemorySize / 4; i++) {
+	if (a->decodeCache[i].opCode != b->decodeCache[i].opCode)
+	    return FALSE;
+    }
+    for (unsigned int i = 0; i < NumPhysPages; i++) {
+	if (a->codeWritten[i] != b->codeWritten[i])
+	    return FALSE;
+    }
+    return a->quietTicks == b->quietTicks 
+		&& a->batchedTicks == b->batchedTicks
+		&& a->shadowStopped == b->shadowStopped;
+}
+
+//----------------------------------------------------------------------
+// BlockCompiler::Run
+// 	Run the "length" instructions at "instrs" on the shadow machine
+//	"m", the way BlockEngine::Execute does: through "code" as far as
+//	it goes, interpreting each instruction it leaves to us; or, if
+//	"code" is NULL, interpreting them all.  We stop where the real
+//	machine would go into the kernel: an exception, or the end of the
+//	tick batch.  Returns the index we stopped at, or "length".
+//----------------------------------------------------------------------
+
+int
+BlockCompiler::Run(Machine *m, Instruction *instrs, int length, 
+			NativeBlock code)
+{
+    int *registers = m->registers;
+    ExecState state;
+    int i = 0;
+
+    while (i < length) {
+	if (code != NULL) {
+	    i = (*code)(i);
+	    if (i == length)
+		break;
+	}
+	if (m->quietTicks == 0)
+	    return i;
+	state.pcAfter = registers[NextPCReg] + 4;
+	state.loadReg = 0;
+	state.loadValue = 0;
+	if (!(m->*Machine::opHandlers[(int) instrs[i].opCode])(&instrs[i],
+								&state)) {
+	    m->Tick();
+	    return i;
+	}
+	m->DelayedLoad(state.loadReg, state.loadValue);
+	registers[PrevPCReg] = registers[PCReg];
+	registers[PCReg] = registers[NextPCReg];
+	registers[NextPCReg] = state.pcAfter;
+	m->Tick();
+	i++;
+    }
+    return length;
+}
+
+//----------------------------------------------------------------------
+// BlockCompiler::SelfTest
+// 	Check the generated code against the interpreter.  We make up
+//	random blocks (some of nothing but loads and stores), and run
+//	each one from the same random state on two shadows of the real
+//	machine, one interpreting (Machine::ExecuteOp) and one running
+//	the block's code.  The registers, memory, decode cache, ticks,
+//	exception and the index each stopped at must all be the same.
+//
+//	The shadows have memory of their own, and raise exceptions by
+//	just noting them, so this doesn't disturb the real machine.
+//----------------------------------------------------------------------
+
+void
+BlockCompiler::SelfTest()
+{
+    const int NumTests = 4000;
+    const int MaxLength = PageSize / 4;
+    Machine *interp = new Machine(kernel->machine);
+    Machine *native = new Machine(kernel->machine);
+    TranslationEntry *tables = new TranslationEntry[2];
+    Instruction *instrs = new Instruction[MaxLength];
+    int codeSize = MaxCodeSize(MaxLength);
+    char *code = AllocExecutableArray(codeSize);
+    BlockCompiler *compiler;
+    int length, stop;
+    bool memoryOnly;
+
+    DEBUG(dbgMach, "Entering BlockCompiler::SelfTest");
+    interp->mainMemory = new char[MemorySize];
+    interp->decodeCache = new Instruction[MemorySize / 4];
+    native->mainMemory = new char[MemorySize];
+    native->decodeCache = new Instruction[MemorySize / 4];
+    compiler = new BlockCompiler(native);
+
+    for (int n = 0; n < NumTests; n++) {
+	length = 1 + RandomNumber() % MaxLength;
+	memoryOnly = (RandomNumber() % 4 == 0);
+	for (int i = 0; i < length; i++)
+	    RandomInstruction(&instrs[i], memoryOnly);
+	Randomize(interp, tables);
+	Copy(interp, native);
+	if (RandomNumber() % 8 == 0)	// nothing in the cache is ours
+	    interp->pageTable = native->pageTable = &tables[1];
+
+	ASSERT(compiler->Compile(instrs, length, code) <= codeSize);
+	stop = Run(interp, instrs, length, NULL);
+	ASSERT(Run(native, instrs, length, (NativeBlock) code) == stop);
+	ASSERT(Same(interp, native));
+    }
+
+    delete compiler;
+    DeallocExecutableArray(code, codeSize);
+    delete [] interp->mainMemory;
+    delete [] interp->decodeCache;
+    delete [] native->mainMemory;
+    delete [] native->decodeCache;
+    delete interp;
+    delete native;
+    delete [] tables;
+    delete [] instrs;
+}
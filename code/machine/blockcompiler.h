@@ -0,0 +1,103 @@
+// blockcompiler.h
+//	Data structures for translating hot basic blocks of user code
+//	into native code for the host, which is an i386 (Nachos is built
+//	with -m32).  Used by the BlockEngine; see blockengine.h.
+//
+//	The code for a block is a function that works on the simulated
+//	CPU state where it already lives, in Machine::registers: each
+//	MIPS instruction becomes a few host instructions that update the
+//	registers, the delayed load, PC, NextPC and PrevPC, and the tick
+//	batch (see Machine::Tick) exactly as Machine::ExecuteOp and
+//	BlockEngine::Step would.  So the kernel, ReadRegister and
+//	WriteRegister, SaveUserState and the debugger can't tell whether
+//	an instruction was run natively or interpreted.
+//
+//	The generated code never calls back into Nachos.  Whenever it
+//	reaches an instruction it shouldn't run itself, it returns that
+//	instruction's index; the engine interprets it (a fallback), and
+//	then re-enters the code just after it.  We fall back on:
+//
+//	   syscalls, illegal instructions, and ADD, ADDI or SUB when they
+//		overflow -- anything that raises an exception
+//	   loads and stores whose page isn't in the translation cache,
+//		or that aren't aligned; the interpreter translates them
+//		properly, and raises the exception if there is one
+//	   stores into a word that has been decoded (self-modifying
+//		code), since the blocks translated from it must go
+//	   DIV, DIVU, and the partial-word LWL, LWR, SWL and SWR
+//	   the end of a tick batch, where an interrupt may be due
+//
+//	Because every trip into the kernel starts from the interpreter,
+//	a thread is never switched out with generated code on its stack,
+//	and a block's code can be thrown away as soon as the engine has
+//	stopped using it.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef BLOCKCOMPILER_H
+#define BLOCKCOMPILER_H
+
+#include "copyright.h"
+#include "machine.h"
+
+// The generated code for a block.  Runs the block's instructions,
+// starting at index "first", and returns the index of the first one it
+// didn't run: the block's length if it ran to the end, otherwise an
+// instruction the interpreter must run.
+
+typedef int (*NativeBlock)(int first);
+
+class BlockCompiler {
+  public:
+    BlockCompiler(Machine *m);	// Translate blocks to run on "m"
+
+    static int MaxCodeSize(int length);
+				// Most bytes of code Compile can produce
+				// for a block of "length" instructions
+    int Compile(Instruction *instrs, int length, char *code);
+				// Translate a block into "code", which
+				// becomes its NativeBlock; returns the
+				// number of bytes used
+
+    static void SelfTest();	// Compare the code for random blocks
+				// with the interpreter
+
+  private:
+    bool IsNative(int opCode);	// Do we translate this instruction?
+    void Translate(Instruction *instr, bool loadPending, char *fallback);
+				// Emit the code for one instruction
+    void Retire(bool loadPending, int loadReg, bool branch);
+				// Emit the bookkeeping after it
+    void Exit(int index);	// Emit a return of "index"
+
+    // Emitting instructions for the host
+    void Byte(int value);
+    void Word(int value);
+    void Address(void *pointer);
+    void Get(int hostReg, int reg);
+    void Put(int reg, int hostReg);
+    void PutImm(int reg, int value);
+    void Alu(int op, int hostReg, int reg);
+    void AluImm(int op, int hostReg, int value);
+    void Shift(int op, int hostReg, int count);
+    void SetIf(int cond, int hostReg);
+    void Jump(int cond, char *target);
+    char *JumpForward(int cond);
+    void Land(char *jump);
+    void Lookup(bool writing, int size, char *fallback);
+
+    // For SelfTest, on shadow machines
+    static void Randomize(Machine *m, TranslationEntry *tables);
+    static void Copy(Machine *from, Machine *to);
+    static bool Same(Machine *a, Machine *b);
+    static int Run(Machine *m, Instruction *instrs, int length,
+			NativeBlock code);
+
+    Machine *machine;
+    int pageShift;		// log2(PageSize)
+    char *out;			// where the next byte of code goes
+};
+
+#endif // BLOCKCOMPILER_H
@@ -0,0 +1,422 @@
+// blockengine.cc
+//	Routines to run user programs a basic block at a time.
+//	See blockengine.h for the overall design.
+//
+//	The only state we keep between instructions is a pointer to the
+//	block being run, and a pointer is only safe to follow as long as
+//	"epoch" hasn't moved: freeing a block, or any trip into the
+//	kernel (an exception, or another thread running while we were
+//	switched out), bumps it.  So after every instruction we check
+//	the epoch before touching the block again.  The same goes for a
+//	block's native code: it never enters the kernel itself, so we are
+//	never suspended inside it, and can check the epoch whenever it
+//	returns to us.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "blockengine.h"
+#include "mipssim.h"
+#include "main.h"
+
+//----------------------------------------------------------------------
+// EndsBlock, IsBranch
+// 	Classify an opCode for block discovery.  Control transfers end a
+//	block after their delay slot; syscalls and illegal instructions
+//	end it at once, since they always go into the kernel.
+//----------------------------------------------------------------------
+
+static bool
+IsBranch(int opCode)
+{
+    switch (opCode) {
+      case OP_BEQ: case OP_BGEZ: case OP_BGEZAL: case OP_BGTZ:
+      case OP_BLEZ: case OP_BLTZ: case OP_BLTZAL: case OP_BNE:
+      case OP_J: case OP_JAL: case OP_JALR: case OP_JR:
+	return TRUE;
+      default:
+	return FALSE;
+    }
+}
+
+static bool
+EndsBlock(int opCode)
+{
+    return opCode == OP_SYSCALL || opCode == OP_UNIMP || opCode == OP_RES;
+}
+
+//----------------------------------------------------------------------
+// BlockEngine::BlockEngine
+// 	Initialize an empty block cache for "m".
+//
+//	"hotThreshold" -- how many times a block must be entered before
+//		we translate it (1 translates everything on first use)
+//	"cacheSize" -- how many bytes translated blocks may use in all;
+//		rounded up to what one block as long as a page may need
+//----------------------------------------------------------------------
+
+BlockEngine::BlockEngine(Machine *m, int hotThreshold, int cacheSize)
+{
+    machine = m;
+#ifdef x86
+    compiler = new BlockCompiler(m);
+#else
+    compiler = NULL;
+#endif
+    ASSERT(hotThreshold >= 1);
+    if (cacheSize < BlockSize(PageSize / 4))
+	cacheSize = BlockSize(PageSize / 4);
+
+    blockMap = new Block *[MemorySize / 4];
+    entries = new int[MemorySize / 4];
+    for (int i = 0; i < MemorySize / 4; i++) {
+	blockMap[i] = NULL;
+	entries[i] = 0;
+    }
+    for (unsigned int i = 0; i < NumPhysPages; i++)
+	frameBlocks[i] = NULL;
+    this->hotThreshold = hotThreshold;
+    cache = AllocExecutableArray(cacheSize);
+    this->cacheSize = cacheSize;
+    cacheUsed = 0;
+    epoch = 0;
+}
+
+//----------------------------------------------------------------------
+// BlockEngine::~BlockEngine
+// 	Free every translated block.
+//----------------------------------------------------------------------
+
+BlockEngine::~BlockEngine()
+{
+    FlushAll();
+    DeallocExecutableArray(cache, cacheSize);
+    if (compiler != NULL)
+	delete compiler;
+    delete [] blockMap;
+    delete [] entries;
+}
+
+//----------------------------------------------------------------------
+// BlockEngine::FreeBlocks
+// 	Free all the blocks translated from physical page "physPage".
+//	Blocks are only chained to blocks in the same frame, so no
+//	surviving block can point at the ones freed here.  Their space in
+//	the cache isn't reused until the next flush.
+//----------------------------------------------------------------------
+
+void
+BlockEngine::FreeBlocks(int physPage)
+{
+    Block *block, *next;
+
+    if (frameBlocks[physPage] == NULL)
+	return;
+    for (block = frameBlocks[physPage]; block != NULL; block = next) {
+	next = block->nextInFrame;
+	blockMap[block->start / 4] = NULL;
+    }
+    frameBlocks[physPage] = NULL;
+    epoch++;
+}
+
+//----------------------------------------------------------------------
+// BlockEngine::FlushAll
+// 	Free every translated block, and empty the cache.  How often
+//	blocks were entered is kept, so the hot ones are translated again
+//	as soon as they run.
+//----------------------------------------------------------------------
+
+void
+BlockEngine::FlushAll()
+{
+    for (unsigned int i = 0; i < NumPhysPages; i++)
+	FreeBlocks(i);
+    cacheUsed = 0;
+}
+
+//----------------------------------------------------------------------
+// BlockEngine::BlockSize
+// 	Return the most cache space a block of "length" instructions can
+//	take: the Block, its handlers, and (if we compile) its code, each
+//	rounded up to keep the next one aligned.
+//----------------------------------------------------------------------
+
+int
+BlockEngine::BlockSize(int length)
+{
+    int size = divRoundUp(sizeof(Block) + length * sizeof(Machine::OpHandler),
+				CacheAlign) * CacheAlign;
+
+    if (compiler != NULL)
+	size += divRoundUp(BlockCompiler::MaxCodeSize(length), CacheAlign)
+							* CacheAlign;
+    return size;
+}
+
+//----------------------------------------------------------------------
+// BlockEngine::InvalidateFrame
+// 	The contents of physical page "physPage" are changing: free the
+//	blocks translated from it, and forget how hot its code was.
+//----------------------------------------------------------------------
+
+void
+BlockEngine::InvalidateFrame(int physPage)
+{
+    FreeBlocks(physPage);
+    for (unsigned int i = 0; i < PageSize / 4; i++)
+	entries[physPage * PageSize / 4 + i] = 0;
+}
+
+//----------------------------------------------------------------------
+// BlockEngine::Interrupted
+// 	Called whenever the kernel gets control from the user program,
+//	or a thread is about to resume running user code.  Anything a
+//	suspended Execute/Run remembers may be stale.
+//----------------------------------------------------------------------
+
+void
+BlockEngine::Interrupted()
+{
+    epoch++;
+}
+
+//----------------------------------------------------------------------
+// BlockEngine::Find
+// 	Return the translated block that starts at physical address
+//	"physAddr".  If there is none, count the entry, and translate the
+//	block once it has become hot.  Returns NULL if the block is still
+//	cold and should be interpreted.
+//
+//	Note that translating may flush the whole cache.
+//----------------------------------------------------------------------
+
+BlockEngine::Block *
+BlockEngine::Find(int physAddr)
+{
+    Block *block = blockMap[physAddr / 4];
+
+    if (block == NULL && ++entries[physAddr / 4] >= hotThreshold)
+	block = Build(physAddr);
+    return block;
+}
+
+//----------------------------------------------------------------------
+// BlockEngine::Build
+// 	Translate the block starting at physical address "physAddr":
+//	decode forward to the end of the block, bind each instruction to
+//	its handler, and compile the block if we can.  If the new block
+//	might not fit in the cache, flush the cache first.
+//----------------------------------------------------------------------
+
+BlockEngine::Block *
+BlockEngine::Build(int physAddr)
+{
+    int frame = physAddr / PageSize;
+    int end = (frame + 1) * PageSize;
+    int addr, length, used;
+    bool inDelaySlot = FALSE;
+    Instruction *instr;
+    Block *block;
+
+    length = 0;
+    for (addr = physAddr; addr < end; addr += 4) {
+	instr = machine->DecodeAt(addr);
+	length++;
+	if (inDelaySlot || EndsBlock(instr->opCode))
+	    break;
+	inDelaySlot = IsBranch(instr->opCode);
+    }
+
+    if (cacheUsed + BlockSize(length) > cacheSize) {
+	DEBUG(dbgMach, "Block cache full, flushing " << cacheUsed << " bytes");
+	FlushAll();
+	kernel->stats->numBlockFlushes++;
+    }
+    kernel->stats->numBlocksTranslated++;
+
+    block = (Block *) (cache + cacheUsed);
+    block->start = physAddr;
+    block->length = length;
+    block->instrs = &machine->decodeCache[physAddr / 4];
+    block->handlers = (Machine::OpHandler *) (block + 1);
+    for (int i = 0; i < length; i++)
+	block->handlers[i] = Machine::opHandlers[(int) block->instrs[i].opCode];
+    block->next[0] = block->next[1] = NULL;
+    used = divRoundUp(sizeof(Block) + length * sizeof(Machine::OpHandler),
+				CacheAlign) * CacheAlign;
+    if (compiler != NULL) {
+	block->code = (NativeBlock) (cache + cacheUsed + used);
+	used += compiler->Compile(block->instrs, length, 
+				cache + cacheUsed + used);
+    } else
+	block->code = NULL;
+    cacheUsed += divRoundUp(used, CacheAlign) * CacheAlign;
+
+    block->nextInFrame = frameBlocks[frame];
+    frameBlocks[frame] = block;
+    blockMap[physAddr / 4] = block;
+    return block;
+}
+
+//----------------------------------------------------------------------
+// BlockEngine::Step
+// 	Run one instruction exactly as OneInstruction would once it has
+//	fetched and decoded it: the delayed load and the PC updates are
+//	applied only if the instruction completes, and it costs one tick
+//	either way (see Machine::Tick).
+//
+//	Returns FALSE if the instruction raised an exception.
+//----------------------------------------------------------------------
+
+bool
+BlockEngine::Step(Instruction *instr, Machine::OpHandler handler)
+{
+    int *registers = machine->registers;
+    ExecState state;
+    bool ok;
+
+    state.pcAfter = registers[NextPCReg] + 4;
+    state.loadReg = 0;
+    state.loadValue = 0;
+    ok = (machine->*handler)(instr, &state);
+    if (ok) {
+	machine->DelayedLoad(state.loadReg, state.loadValue);
+	registers[PrevPCReg] = registers[PCReg];
+	registers[PCReg] = registers[NextPCReg];
+	registers[NextPCReg] = state.pcAfter;
+    }
+    machine->Tick();
+    return ok;
+}
+
+//----------------------------------------------------------------------
+// BlockEngine::Execute
+// 	Run the instructions of "block", starting at its first.  If the
+//	block was compiled, its code runs as many of them as it can, and
+//	we interpret each one it leaves to us before going back into it.
+//
+//	Returns TRUE if we ran off the end of the block, FALSE if we had
+//	to stop early (an exception, or the epoch moved while we were
+//	ticking, so "block" may no longer exist).
+//----------------------------------------------------------------------
+
+bool
+BlockEngine::Execute(Block *block)
+{
+    unsigned int startEpoch = epoch;
+    int pc = machine->registers[PCReg];
+    int i = 0;
+
+    while (i < block->length) {
+	if (block->code != NULL) {
+	    i = (*block->code)(i);
+	    if (i == block->length)
+		break;
+	}
+	if (!Step(&block->instrs[i], block->handlers[i]) 
+					|| epoch != startEpoch)
+	    return FALSE;
+	i++;
+	if (i < block->length && machine->registers[PCReg] != pc + 4 * i)
+	    return FALSE;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// BlockEngine::Interpret
+// 	Run the block starting at physical address "physAddr" without
+//	translating it, decoding (through the decode cache) and
+//	dispatching each instruction as we reach it.  We stop at the same
+//	place Build would end the block.
+//
+//	Returns TRUE if we reached the end of the block.
+//----------------------------------------------------------------------
+
+bool
+BlockEngine::Interpret(int physAddr)
+{
+    int end = (physAddr / PageSize + 1) * PageSize;
+    unsigned int startEpoch = epoch;
+    int pc = machine->registers[PCReg];
+    bool inDelaySlot = FALSE;
+    Instruction *instr;
+    int opCode;
+
+    for (int addr = physAddr; addr < end; addr += 4) {
+	instr = machine->DecodeAt(addr);
+	opCode = instr->opCode;		// the instruction may overwrite itself
+	if (!Step(instr, Machine::opHandlers[opCode]) || epoch != startEpoch)
+	    return FALSE;
+	if (inDelaySlot || EndsBlock(opCode))
+	    return TRUE;
+	inDelaySlot = IsBranch(opCode);
+	pc += 4;
+	if (machine->registers[PCReg] != pc)
+	    return FALSE;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// BlockEngine::Run
+// 	Simulate the execution of the user program in the current thread,
+//	a block at a time.  Called from Machine::Run; never returns.
+//
+//	Entering a block normally means a full Translate of the PC, which
+//	also sets the page's use bit and lets the replacement algorithm
+//	see the reference.  When the previous block ran to completion
+//	without the kernel getting involved, and the new PC is in the same
+//	page, the translation can't have changed: we follow (or make) a
+//	chain link instead, and only record the reference to the page.
+//----------------------------------------------------------------------
+
+void
+BlockEngine::Run()
+{
+    int *registers = machine->registers;
+    Block *block = NULL;	// last block run to completion, or NULL
+    unsigned int blockEpoch = 0;
+    unsigned int vpn = 0;	// virtual page "block" was run from
+    int pc, physAddr, link;
+    ExceptionType exception;
+    Block *next;
+
+    for (;;) {
+	pc = registers[PCReg];
+	if (block != NULL && blockEpoch == epoch && machine->tlb == NULL
+			&& (pc & 0x3) == 0 && (unsigned) pc / PageSize == vpn) {
+	    physAddr = (block->start / PageSize) * PageSize + pc % PageSize;
+	    machine->TouchPage(&machine->pageTable[vpn]);
+	    link = (physAddr == block->start + block->length * 4) ? 0 : 1;
+	    next = block->next[link];
+	    if (next == NULL || next->start != physAddr) {
+		next = Find(physAddr);
+		if (next != NULL && blockEpoch == epoch)
+		    block->next[link] = next;
+	    }
+	} else {
+	    exception = machine->TranslateCached(pc, &physAddr, 4, FALSE);
+	    if (exception != NoException) {
+		machine->RaiseException(exception, pc);
+		machine->Tick();
+		block = NULL;
+		continue;
+	    }
+	    vpn = (unsigned) pc / PageSize;
+	    next = Find(physAddr);
+	}
+
+	block = NULL;
+	if (next == NULL)
+	    Interpret(physAddr);
+	else {
+	    blockEpoch = epoch;
+	    if (Execute(next))
+		block = next;
+	}
+    }
+}
@@ -0,0 +1,114 @@
+// blockengine.h
+//	Data structures for running user programs a basic block at a
+//	time, rather than fetching and dispatching every instruction
+//	through Machine::OneInstruction.
+//
+//	A basic block is a run of instructions within one physical page
+//	that ends after a branch or jump and its delay slot, at a syscall
+//	or illegal instruction, or at the end of the page.  Once a block
+//	has been entered "hotThreshold" times it is translated: on an
+//	i386 host, into native code (see blockcompiler.h), which falls
+//	back to the interpreter for whatever it can't do itself; on other
+//	hosts, into an array of Machine::ExecuteOp handlers to walk down.
+//	Until then it is interpreted an instruction at a time, so code
+//	that only runs once (initialization, most of a short program)
+//	costs nothing to translate.  Blocks that follow one another in
+//	the same page are chained, so control passes between them without
+//	a full address translation or a table lookup.
+//
+//	Blocks are keyed by physical address.  They are thrown away when
+//	the contents of their frame change -- a store into decoded code,
+//	or the kernel loading a different page into the frame.  Blocks and
+//	their code are allocated one after another from a single region
+//	of "cacheSize" bytes; when a new block doesn't fit we flush them
+//	all and start over, which is simple and only hurts when the
+//	working set of hot code really is larger than the cache.  (The
+//	space of blocks thrown away before then is only reclaimed by the
+//	flush.)
+//
+//	Each instruction still takes one tick, and after each one the
+//	PC, NextPC and delayed-load registers are exactly what
+//	OneInstruction would have left, so interrupts, context switches
+//	and exceptions all happen at the same simulated time as before.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef BLOCKENGINE_H
+#define BLOCKENGINE_H
+
+#include "copyright.h"
+#include "machine.h"
+#include "blockcompiler.h"
+
+class BlockEngine {
+  public:
+    BlockEngine(Machine *m, int hotThreshold, int cacheSize);
+				// Start with no translated blocks
+    ~BlockEngine();		// Throw away all translated blocks
+
+    void Run();			// Run the user program in the current
+				// thread; never returns
+
+    void InvalidateFrame(int physPage);
+				// The contents of a frame are changing;
+				// drop the blocks translated from it
+    void Interrupted();		// The kernel has run, so nothing we
+				// remember about the running block
+				// (its translation, its PC) can be trusted
+
+  private:
+    class Block {
+      public:
+	int start;		// physical address of the first instruction
+	int length;		// number of instructions
+	Instruction *instrs;	// the decoded instructions, which live
+				// in Machine::decodeCache
+	Machine::OpHandler *handlers;
+				// ExecuteOp for each instruction
+	NativeBlock code;	// the native code, or NULL if the host
+				// can't run any
+	Block *next[2];		// successors in the same frame we have
+				// chained to: [0] falls through off the
+				// end, [1] anything else (a branch target)
+	Block *nextInFrame;	// other blocks translated from this frame
+    };
+
+    Block *Find(int physAddr);	// Find the block starting at an address,
+				// translating it if it has become hot
+    Block *Build(int physAddr);	// Translate the block at an address
+    void FreeBlocks(int physPage);
+				// Free the blocks translated from a frame
+    void FlushAll();		// Throw away every translated block
+    int BlockSize(int length);	// Most cache space a block can take
+
+    bool Step(Instruction *instr, Machine::OpHandler handler);
+				// Run one instruction and its tick
+    bool Execute(Block *block);	// Run a block; FALSE if it stopped early
+    bool Interpret(int physAddr);
+				// Run a block that hasn't been translated
+
+    Machine *machine;
+    BlockCompiler *compiler;	// NULL if the host isn't an i386
+    Block **blockMap;		// block starting at each physical word
+    Block *frameBlocks[NumPhysPages];
+				// blocks translated from each frame
+    int *entries;		// times we entered each physical word as
+				// the start of an untranslated block
+    int hotThreshold;		// entries before a block is translated
+    char *cache;		// where translated blocks are allocated
+    int cacheSize;		// its size in bytes
+    int cacheUsed;		// bytes allocated since the last flush
+    unsigned int epoch;		// bumped whenever a block is freed or the
+				// kernel runs, to tell a thread executing
+				// a block that it must look again
+};
+
+const int DefaultHotThreshold = 8;	// see BlockEngine::hotThreshold
+const int CacheAlign = 16;		// alignment of each block and its
+					// code in BlockEngine::cache
+const int DefaultBlockCacheSize = 64 * 1024;
+					// see BlockEngine::cacheSize
+
+#endif // BLOCKENGINE_H
@@ -36,8 +36,8 @@ ConsoleInput::ConsoleInput(char *readFile, CallBackObj *toCall)
     callWhenAvail = toCall;
     incoming = EOF;
 
-    // start polling for incoming keystrokes
-    kernel->interrupt->Schedule(this, ConsoleTime, ConsoleReadInt);
+    // wait for incoming keystrokes
+    kernel->interrupt->WatchInput(readFileNo, this, ConsoleTime, ConsoleReadInt);
 }
 
 //----------------------------------------------------------------------
@@ -68,8 +68,8 @@ ConsoleInput::CallBack()
 
     ASSERT(incoming == EOF);
     if (!PollFile(readFileNo)) { // nothing to be read
-        // schedule the next time to poll for a packet
-        kernel->interrupt->Schedule(this, ConsoleTime, ConsoleReadInt);
+        // wait for the next keystroke
+        kernel->interrupt->WatchInput(readFileNo, this, ConsoleTime, ConsoleReadInt);
     } else { 
     	// otherwise, read character and tell user about it
     	Read(readFileNo, &c, sizeof(char));
@@ -90,8 +90,8 @@ ConsoleInput::GetChar()
 {
    char ch = incoming;
 
-   if (incoming != EOF) {	// schedule when next char will arrive
-       kernel->interrupt->Schedule(this, ConsoleTime, ConsoleReadInt);
+   if (incoming != EOF) {	// wait for the next char to arrive
+       kernel->interrupt->WatchInput(readFileNo, this, ConsoleTime, ConsoleReadInt);
    }
    incoming = EOF;
    return ch;
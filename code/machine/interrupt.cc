@@ -55,10 +55,10 @@ PendingInterrupt::PendingInterrupt(CallBackObj *callOnInt,
 //----------------------------------------------------------------------
 
 static int
-PendingCompare (PendingInterrupt *x, PendingInterrupt *y)
+PendingCompare (PendingInterrupt x, PendingInterrupt y)
 {
-    if (x->when < y->when) { return -1; }
-    else if (x->when > y->when) { return 1; }
+    if (x.when < y.when) { return -1; }
+    else if (x.when > y.when) { return 1; }
     else { return 0; }
 }
 
@@ -72,7 +72,10 @@ PendingCompare (PendingInterrupt *x, PendingInterrupt *y)
 Interrupt::Interrupt()
 {
     level = IntOff;
-    pending = new SortedList<PendingInterrupt *>(PendingCompare);
+    pending = new Heap<PendingInterrupt>(PendingCompare);
+    numWatches = numArmed = 0;
+    for (int i = 0; i < MaxCpus; i++)
+	ipiPending[i] = FALSE;
     inHandler = FALSE;
     yieldOnReturn = FALSE;
     status = SystemMode;
@@ -85,9 +88,6 @@ Interrupt::Interrupt()
 
 Interrupt::~Interrupt()
 {
-    while (!pending->IsEmpty()) {
-	delete pending->RemoveFront();
-    }
     delete pending;
 }
 
@@ -149,15 +149,22 @@ Interrupt::OneTick()
 {
     MachineStatus oldStatus = status;
     Statistics *stats = kernel->stats;
+    Scheduler *scheduler = kernel->scheduler;
+    int tick;
 
 // advance simulated time
     if (status == SystemMode) {
-        stats->totalTicks += SystemTick;
+	tick = SystemTick;
 	stats->systemTicks += SystemTick;
     } else {					// USER_PROGRAM
-	stats->totalTicks += UserTick;
+	tick = UserTick;
 	stats->userTicks += UserTick;
     }
+    if (scheduler->NumCpus() > 1)	// the clock can only move as far
+					// as the slowest processor
+	stats->totalTicks = scheduler->ChargeTick(tick);
+    else
+	stats->totalTicks += tick;
     DEBUG(dbgInt, "== Tick " << stats->totalTicks << " ==");
 
 // check any pending interrupts are now ready to fire
@@ -165,16 +172,88 @@ Interrupt::OneTick()
 				// (interrupt handlers run with
 				// interrupts disabled)
     CheckIfDue(FALSE);		// check for pending interrupts
+    scheduler->RunTasks();	// and the work they left for tasks
     ChangeLevel(IntOff, IntOn);	// re-enable interrupts
+    if (ipiPending[scheduler->CurrentCpu()]) {
+	ipiPending[scheduler->CurrentCpu()] = FALSE;
+	yieldOnReturn = TRUE;	// another processor asked us to
+				// reschedule
+    }
     if (yieldOnReturn) {	// if the timer device handler asked 
     				// for a context switch, ok to do it now
 	yieldOnReturn = FALSE;
  	status = SystemMode;		// yield is a kernel routine
 	kernel->currentThread->Yield();
 	status = oldStatus;
+    } else if (scheduler->NumCpus() > 1) {
+	// let the next processor run for a tick.  We come back here
+	// when it is this processor's turn again.
+	int next = scheduler->NextCpu();
+
+	if (next != scheduler->CurrentCpu()) {
+	    ChangeLevel(IntOn, IntOff);
+	    status = SystemMode;
+	    scheduler->SwitchCpu(next, oldStatus == UserMode);
+	    status = oldStatus;
+	    ChangeLevel(IntOff, IntOn);
+	}
     }
 }
 
+//----------------------------------------------------------------------
+// Interrupt::QuietUserTicks
+// 	Return how many user instructions in a row could each be followed
+//	by OneTick without any interrupt coming due, so the caller may
+//	run them and then account for them all with AdvanceUserTicks.
+//	The instruction after those must go through OneTick as usual.
+//
+//	Nothing but an interrupt handler can ask for a context switch,
+//	so skipping OneTick for these instructions changes nothing the
+//	program or the kernel can see.  The answer is only good until the
+//	kernel runs again, since it may schedule new interrupts.
+//
+//	Returns 0 if interrupt tracing is on, so that every tick is still
+//	printed, and while a kernel task is posted, so that it runs at
+//	the next tick.
+//----------------------------------------------------------------------
+
+int
+Interrupt::QuietUserTicks()
+{
+    const int MaxQuietTicks = 1000000;	// keep totalTicks from overflowing
+    int quiet;
+
+    ASSERT(level == IntOn && status == UserMode);
+    if (debug->IsEnabled(dbgInt) || kernel->scheduler->NumCpus() > 1)
+	return 0;		// every tick may switch processors
+    if (kernel->scheduler->HasTasks())
+	return 0;
+    if (pending->IsEmpty())
+	return MaxQuietTicks;
+    quiet = (pending->Front().when - kernel->stats->totalTicks - 1) / UserTick;
+    if (quiet < 0)
+	return 0;
+    return min(quiet, MaxQuietTicks);
+}
+
+//----------------------------------------------------------------------
+// Interrupt::AdvanceUserTicks
+// 	Advance simulated time for "numTicks" user instructions that have
+//	already run.  The caller must have made sure no interrupt came due
+//	during them (see QuietUserTicks).
+//----------------------------------------------------------------------
+
+void
+Interrupt::AdvanceUserTicks(int numTicks)
+{
+    Statistics *stats = kernel->stats;
+
+    ASSERT(status == UserMode);
+    stats->totalTicks += numTicks * UserTick;
+    stats->userTicks += numTicks * UserTick;
+    ASSERT(pending->IsEmpty() || pending->Front().when > stats->totalTicks);
+}
+
 //----------------------------------------------------------------------
 // Interrupt::YieldOnReturn
 // 	Called from within an interrupt handler, to cause a context switch
@@ -193,13 +272,33 @@ Interrupt::YieldOnReturn()
     yieldOnReturn = TRUE; 
 }
 
+//----------------------------------------------------------------------
+// Interrupt::SendIPI
+// 	Send an inter-processor interrupt to processor "cpu": the next
+//	time it ticks, it reschedules, as if its timer had gone off.
+//	An idle processor is woken up, so it will look for work.
+//
+//	"cpu" is the processor to interrupt
+//----------------------------------------------------------------------
+
+void
+Interrupt::SendIPI(int cpu)
+{
+    ASSERT(0 <= cpu && cpu < kernel->scheduler->NumCpus());
+    DEBUG(dbgInt, "IPI to processor " << cpu);
+    ipiPending[cpu] = TRUE;
+    kernel->stats->numIPIs++;
+    kernel->scheduler->WakeCpu(cpu);
+}
+
 //----------------------------------------------------------------------
 // Interrupt::Idle
 // 	Routine called when there is nothing in the ready queue.
 //
 //	Since something has to be running in order to put a thread
-//	on the ready queue, the only thing to do is to advance 
-//	simulated time until the next scheduled hardware interrupt.
+//	on the ready queue, the only thing to do is to run any kernel
+//	tasks that have been posted, or else advance simulated time
+//	until the next scheduled hardware interrupt.
 //
 //	If there are no pending interrupts, stop.  There's nothing
 //	more for us to do.
@@ -209,16 +308,35 @@ Interrupt::Idle()
 {
     DEBUG(dbgInt, "Machine idling; checking for interrupts.");
     status = IdleMode;
-    if (CheckIfDue(TRUE)) {	// check for any pending interrupts
+    if (AnyInputWatched())	// input that has already arrived comes
+	CheckForInput(FALSE);	// before anything further in the future
+    if (kernel->scheduler->RunTasks() || CheckIfDue(TRUE)) {
+				// run any posted tasks, else check for
+				// any pending interrupts
 	status = SystemMode;
 	return;			// return in case there's now
 				// a runnable thread
     }
 
+    // if there are no pending interrupts, but the console or the network
+    // is waiting for input, nothing can happen until the input arrives:
+    // wait for it on the host, then advance the clock to its interrupt.
+    // The timer turns itself off when the machine goes idle, so turn it
+    // back on for the threads the input will wake up.
+    if (AnyInputWatched()) {
+	DEBUG(dbgInt, "Machine idle.  Waiting for input.");
+	CheckForInput(TRUE);
+	kernel->alarm->Resume();
+	CheckIfDue(TRUE);
+	kernel->scheduler->RunTasks();
+	status = SystemMode;
+	return;
+    }
+
     // if there are no pending interrupts, and nothing is on the ready
-    // queue, it is time to stop.   If the console or the network is 
-    // operating, there are *always* pending interrupts, so this code
-    // is not reached.  Instead, the halt must be invoked by the user program.
+    // queue, it is time to stop.  If the console or the network is 
+    // operating, we wait above instead, so this code is not reached.
+    // Instead, the halt must be invoked by the user program.
 
     DEBUG(dbgInt, "Machine idle.  No interrupts to do.");
     cout << "No threads ready or runnable, and no pending interrupts.\n";
@@ -234,6 +352,8 @@ void
 Interrupt::Halt()
 {
     cout << "Machine halting!\n\n";
+    kernel->scheduler->PrintShares();
+    kernel->scheduler->PrintCpus();
     kernel->stats->Print();
     delete kernel;	// Never returns.
 }
@@ -243,7 +363,8 @@ Interrupt::Halt()
 // 	Arrange for the CPU to be interrupted when simulated time
 //	reaches "now + when".
 //
-//	Implementation: just put it on a sorted list.
+//	Implementation: just put it in a heap ordered on "when".  Interrupts
+//	scheduled for the same time fire in the order they were scheduled.
 //
 //	NOTE: the Nachos kernel should not call this routine directly.
 //	Instead, it is only called by the hardware device simulators.
@@ -257,12 +378,103 @@ void
 Interrupt::Schedule(CallBackObj *toCall, int fromNow, IntType type)
 {
     int when = kernel->stats->totalTicks + fromNow;
-    PendingInterrupt *toOccur = new PendingInterrupt(toCall, when, type);
 
     DEBUG(dbgInt, "Scheduling interrupt handler the " << intTypeNames[type] << " at time = " << when);
     ASSERT(fromNow > 0);
 
-    pending->Insert(toOccur);
+    pending->Insert(PendingInterrupt(toCall, when, type));
+}
+
+//----------------------------------------------------------------------
+// Interrupt::WatchInput
+// 	Arrange for a device to be interrupted once there is input on a
+//	host file or socket: the console keyboard, or the network.
+//	Devices used to poll for input by scheduling an interrupt every
+//	ConsoleTime or NetworkTime ticks; now nothing is scheduled until
+//	input has actually arrived.
+//
+//	We check for input on the host whenever an interrupt fires
+//	(so at least once per time slice while threads are running),
+//	and when the machine is idle.  If nothing else is going to
+//	happen, Idle waits for input on the host, and simulated time
+//	jumps straight to its arrival.
+//
+//	The watch fires once.  The device calls WatchInput again once
+//	it is ready for more input.
+//
+//	"fd" is the host file or socket to watch
+//	"toCall" is the object to call when the interrupt occurs
+//	"delay" is how many ticks after we notice the input the interrupt
+//		should occur
+//	"type" is the hardware device that generated the interrupt
+//----------------------------------------------------------------------
+
+void
+Interrupt::WatchInput(int fd, CallBackObj *toCall, int delay, IntType type)
+{
+    InputWatch *watch = NULL;
+
+    ASSERT(delay > 0);
+    for (int i = 0; i < numWatches; i++) {
+	if (watches[i].fd == fd)
+	    watch = &watches[i];
+    }
+    if (watch == NULL) {
+	ASSERT(numWatches < MaxInputWatches);
+	watch = &watches[numWatches++];
+	watch->fd = fd;
+	watch->armed = FALSE;
+    }
+    DEBUG(dbgInt, "Watching for input for the " << intTypeNames[type]);
+    watch->callOnInput = toCall;
+    watch->delay = delay;
+    watch->type = type;
+    if (!watch->armed) {
+	watch->armed = TRUE;
+	numArmed++;
+    }
+}
+
+//----------------------------------------------------------------------
+// Interrupt::CheckForInput
+// 	Check the watched files for input, and schedule an interrupt
+//	for each one that has some.
+//
+// Returns:
+//	TRUE, if any interrupt was scheduled
+// Params:
+//	"block" -- if TRUE, wait on the host until some input arrives
+//----------------------------------------------------------------------
+
+bool
+Interrupt::CheckForInput(bool block)
+{
+    int fds[MaxInputWatches];
+    InputWatch *armed[MaxInputWatches];
+    int numFds, ready;
+    bool found = FALSE;
+
+    for (;;) {
+	numFds = 0;
+	for (int i = 0; i < numWatches; i++) {
+	    if (watches[i].armed) {
+		armed[numFds] = &watches[i];
+		fds[numFds++] = watches[i].fd;
+	    }
+	}
+	if (numFds == 0)
+	    return found;
+	ready = WaitForInput(fds, numFds, block && !found);
+	if (ready < 0)
+	    return found;
+
+	InputWatch *watch = armed[ready];
+	watch->armed = FALSE;
+	numArmed--;
+	found = TRUE;
+	DEBUG(dbgInt, "Input arrived for the " << intTypeNames[watch->type]);
+	Schedule(watch->callOnInput, watch->delay, watch->type);
+    }
 }
 
 //----------------------------------------------------------------------
@@ -280,7 +492,7 @@ Interrupt::Schedule(CallBackObj *toCall, int fromNow, IntType type)
 bool
 Interrupt::CheckIfDue(bool advanceClock)
 {
-    PendingInterrupt *next;
+    PendingInterrupt next;
     Statistics *stats = kernel->stats;
 
     ASSERT(level == IntOff);		// interrupts need to be disabled,
@@ -292,18 +504,21 @@ Interrupt::CheckIfDue(bool advanceClock)
 	return FALSE;	
     }		
     next = pending->Front();
-    if (next->when > stats->totalTicks) {
+    if (next.when > stats->totalTicks) {
         if (!advanceClock) {		// not time yet
             return FALSE;
         }
         else {      		// advance the clock to next interrupt
-	    stats->idleTicks += (next->when - stats->totalTicks);
-	    stats->totalTicks = next->when;
+	    stats->idleTicks += (next.when - stats->totalTicks);
+	    stats->totalTicks = next.when;
 	}
     }
 
+    if (numArmed > 0)			// pick up any input that has
+	CheckForInput(FALSE);		// arrived since we last looked
+
     DEBUG(dbgInt, "Invoking interrupt handler for the ");
-    DEBUG(dbgInt, intTypeNames[next->type] << " at time " << next->when);
+    DEBUG(dbgInt, intTypeNames[next.type] << " at time " << next.when);
 #ifdef USER_PROGRAM
     if (kernel->machine != NULL) {
     	kernel->machine->DelayedLoad(0, 0);
@@ -311,11 +526,10 @@ Interrupt::CheckIfDue(bool advanceClock)
 #endif
     inHandler = TRUE;
     do {
-        next = pending->RemoveFront();    // pull interrupt off list
-        next->callOnInterrupt->CallBack();// call the interrupt handler
-	delete next;
+        next = pending->RemoveFront();    // pull interrupt off the heap
+        next.callOnInterrupt->CallBack();// call the interrupt handler
     } while (!pending->IsEmpty() 
-    		&& (pending->Front()->when <= stats->totalTicks));
+    		&& (pending->Front().when <= stats->totalTicks));
     inHandler = FALSE;
     return TRUE;
 }
@@ -327,10 +541,10 @@ Interrupt::CheckIfDue(bool advanceClock)
 //----------------------------------------------------------------------
 
 static void
-PrintPending (PendingInterrupt *pending)
+PrintPending (PendingInterrupt pending)
 {
-    cout << "Interrupt handler "<< intTypeNames[pending->type];
-    cout << ", scheduled at " << pending->when;
+    cout << "Interrupt handler "<< intTypeNames[pending.type];
+    cout << ", scheduled at " << pending.when;
 }
 
 //----------------------------------------------------------------------
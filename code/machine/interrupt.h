@@ -36,7 +36,7 @@
 #define INTERRUPT_H
 
 #include "copyright.h"
-#include "list.h"
+#include "heap.h"
 #include "callback.h"
 
 // Interrupts can be disabled (IntOff) or enabled (IntOn)
@@ -59,6 +59,7 @@ enum IntType { TimerInt, DiskInt, ConsoleWriteInt, ConsoleReadInt,
 
 class PendingInterrupt {
   public:
+    PendingInterrupt() {}	// needed to keep these in a Heap
     PendingInterrupt(CallBackObj *callOnInt, int time, IntType kind);
 				// initialize an interrupt that will
 				// occur in the future
@@ -70,6 +71,23 @@ class PendingInterrupt {
     IntType type;		// for debugging
 };
 
+// The following class records a device waiting for input from the
+// host (see Interrupt::WatchInput).
+
+class InputWatch {
+  public:
+    int fd;			// host file or socket to wait on
+    CallBackObj *callOnInput;	// device to interrupt once it is readable
+    int delay;			// ticks from noticing input to the interrupt
+    IntType type;		// for debugging
+    bool armed;			// still waiting?
+};
+
+const int MaxInputWatches = 4;	// console and network input, with room
+				// for more
+
+const int MaxCpus = 8;		// processors in a multiprocessor (-cpus)
+
 // The following class defines the data structures for the simulation
 // of hardware interrupts.  We record whether interrupts are enabled
 // or disabled, and any hardware interrupts that are scheduled to occur
@@ -99,12 +117,24 @@ class Interrupt {
     void YieldOnReturn();	// cause a context switch on return 
 				// from an interrupt handler
 
+    void SendIPI(int cpu);	// interrupt another processor: it
+				// reschedules at its next tick, and
+				// wakes up if it was idle
+    void ClearIPI(int cpu) { ipiPending[cpu] = FALSE; }
+				// the processor has rescheduled
+    bool IsIPIPending(int cpu) { return ipiPending[cpu]; }
+
     MachineStatus getStatus() { return status; } 
     void setStatus(MachineStatus st) { status = st; }
         			// idle, kernel, user
 
     bool AnyFutureInterrupts() { return !pending->IsEmpty(); }
     				// are any interrupts scheduled?
+    int NextInterruptTime() { return pending->IsEmpty() ? -1
+					: pending->Front().when; }
+				// when the next one is due; -1 if none
+    bool AnyInputWatched() { return numArmed > 0; }
+				// is any device waiting for input?
 
     void DumpState();		// Print interrupt state
     
@@ -119,13 +149,33 @@ class Interrupt {
 				// at time "when".  This is called
     				// by the hardware device simulators.
     
+    void WatchInput(int fd, CallBackObj *callTo, int delay, IntType type);
+				// Once the host file "fd" has input,
+				// schedule an interrupt "delay" ticks
+				// later.  Fires only once; call again
+				// to wait for more input.
+
     void OneTick();       	// Advance simulated time
 
+    int QuietUserTicks();	// How many user instructions can run
+				// before any interrupt is due
+    void AdvanceUserTicks(int numTicks);
+				// Account for that many user instructions
+				// at once, without checking for interrupts
+
   private:
     IntStatus level;		// are interrupts enabled or disabled?
-    SortedList<PendingInterrupt *> *pending;		
-    				// the list of interrupts scheduled
-				// to occur in the future
+    Heap<PendingInterrupt> *pending;		
+    				// the interrupts scheduled to occur
+				// in the future, kept by value so
+				// scheduling one doesn't allocate
+    InputWatch watches[MaxInputWatches];
+				// devices waiting for input, instead of
+				// polling for it with periodic interrupts
+    int numWatches;		// entries in use in "watches"
+    int numArmed;		// how many of them are armed
+    bool ipiPending[MaxCpus];	// processors sent an IPI that haven't
+				// rescheduled yet
     bool inHandler;		// TRUE if we are running an interrupt handler
     bool yieldOnReturn; 	// TRUE if we are to context switch
 				// on return from the interrupt handler
@@ -136,6 +186,10 @@ class Interrupt {
     bool CheckIfDue(bool advanceClock); 
     				// Check if any interrupts are supposed
 				// to occur now, and if so, do them
+    bool CheckForInput(bool block);
+				// Schedule the interrupts of watched
+				// files that have input; if "block",
+				// wait on the host until one does
 
     void ChangeLevel(IntStatus old, 	// SetLevel, without advancing the
 			IntStatus now); // simulated time
@@ -9,6 +9,8 @@
 
 #include "copyright.h"
 #include "machine.h"
+#include "blockengine.h"
+#include "parallel.h"
 #include "main.h"
 
 // Textual names of the exceptions that can be generated by user program
@@ -50,9 +52,22 @@ void CheckEndian()
 //
 //	"debug" -- if TRUE, drop into the debugger after each user instruction
 //		is executed.
+//	"useBlocks" -- if TRUE, execute user code with the basic-block
+//		engine.  Ignored when single stepping, tracing the machine
+//		('m') or tracing addresses ('a'), which need
+//		OneInstruction's per-instruction hooks and fetches.
+//	"hotThreshold", "blockCacheSize" -- tuning for the block engine,
+//		see blockengine.h; 0 means use the default.
+//	"hostParallel" -- if TRUE, and we are simulating a multiprocessor,
+//		run the processors' user code on host threads (see
+//		parallel.h).  Ignored when debugging, tracing addresses
+//		('a'), or when the replacement algorithm wants to see
+//		every reference, since all of those need one instruction
+//		at a time on one host thread.
 //----------------------------------------------------------------------
 
-Machine::Machine(bool debug)
+Machine::Machine(bool debug, bool useBlocks, int hotThreshold, 
+		 int blockCacheSize, bool hostParallel)
 {
     int i;
 
@@ -61,6 +76,9 @@ Machine::Machine(bool debug)
     mainMemory = new char[MemorySize];
     for (i = 0; i < MemorySize; i++)
       	mainMemory[i] = 0;
+    decodeCache = new Instruction[MemorySize / 4];
+    for (i = 0; i < MemorySize / 4; i++)
+	decodeCache[i].opCode = 0;
 #ifdef USE_TLB
     tlb = new TranslationEntry[TLBSize];
     for (i = 0; i < TLBSize; i++)
@@ -71,10 +89,67 @@ Machine::Machine(bool debug)
     pageTable = NULL;
 #endif
 
+    useTransCache = (tlb == NULL) && !::debug->IsEnabled(dbgAddr);
+    touchOnHit = AddrSpace::WantsEveryReference();
+    FlushTranslations();
+
     singleStep = debug;
+    batchTicks = !::debug->IsEnabled(dbgMach);
+    quietTicks = batchedTicks = 0;
+    if (hotThreshold <= 0)
+	hotThreshold = DefaultHotThreshold;
+    if (blockCacheSize <= 0)
+	blockCacheSize = DefaultBlockCacheSize;
+    if (useBlocks && !debug && !::debug->IsEnabled(dbgMach)
+				&& !::debug->IsEnabled(dbgAddr))
+	blockEngine = new BlockEngine(this, hotThreshold, blockCacheSize);
+    else
+	blockEngine = NULL;
+    shadow = shadowStopped = FALSE;
+    codeWritten = NULL;
+    if (hostParallel && kernel->scheduler->NumCpus() > 1 && !debug 
+			&& batchTicks && useTransCache && !touchOnHit)
+	parallel = new ParallelRunner(this, kernel->scheduler->NumCpus());
+    else
+	parallel = NULL;
     CheckEndian();
 }
 
+//----------------------------------------------------------------------
+// Machine::Machine
+// 	Initialize a shadow of the machine "real", for a ParallelRunner.
+//	The shadow shares main memory and the decode cache with "real",
+//	but has its own registers and translation cache, so it can run
+//	the user code of one processor while other shadows run the
+//	others.  The ParallelRunner loads its registers and page table.
+//----------------------------------------------------------------------
+
+Machine::Machine(Machine *real)
+{
+    for (int i = 0; i < NumTotalRegs; i++)
+        registers[i] = 0;
+    mainMemory = real->mainMemory;
+    decodeCache = real->decodeCache;
+    tlb = NULL;
+    pageTable = NULL;
+    pageTableSize = 0;
+
+    useTransCache = TRUE;
+    touchOnHit = FALSE;
+    FlushTranslations();
+
+    singleStep = FALSE;
+    batchTicks = FALSE;
+    quietTicks = batchedTicks = 0;
+    blockEngine = NULL;
+    parallel = NULL;
+    shadow = TRUE;
+    shadowStopped = FALSE;
+    codeWritten = new bool[NumPhysPages];
+    for (unsigned int i = 0; i < NumPhysPages; i++)
+	codeWritten[i] = FALSE;
+}
+
 //----------------------------------------------------------------------
 // Machine::~Machine
 // 	De-allocate the data structures used to simulate user program execution.
@@ -82,11 +157,61 @@ Machine::Machine(bool debug)
 
 Machine::~Machine()
 {
+    if (shadow) {
+	delete [] codeWritten;
+	return;			// nothing else of our own but registers
+    }
+    if (parallel != NULL)
+	delete parallel;
     delete [] mainMemory;
+    delete [] decodeCache;
+    if (blockEngine != NULL)
+	delete blockEngine;
     if (tlb != NULL)
         delete [] tlb;
 }
 
+//----------------------------------------------------------------------
+// Machine::PageTableChanged
+// 	Called by the kernel whenever the page table in use may no longer
+//	match what the simulator last saw: on each context switch, since
+//	other threads may have paged our pages out while we were away.
+//	Anything the simulator keeps across instructions that depends
+//	on a translation must be dropped here.
+//----------------------------------------------------------------------
+
+void
+Machine::PageTableChanged()
+{
+    if (blockEngine != NULL)
+	blockEngine->Interrupted();
+}
+
+//----------------------------------------------------------------------
+// Machine::InvalidateDecodeCache
+// 	Throw away the decoded instructions cached for one physical page.
+//	Must be called whenever the kernel changes the contents of the
+//	page behind the simulator's back (swapping a page in, loading
+//	a program), since those writes don't go through WriteMem.
+//
+//	Only the opCode is cleared, so an instruction that is still
+//	being executed out of the cache keeps its operands.
+//
+//	"physPage" -- the physical page whose contents are about to change
+//----------------------------------------------------------------------
+
+void
+Machine::InvalidateDecodeCache(int physPage)
+{
+    ASSERT(physPage >= 0 && physPage < (int) NumPhysPages);
+
+    Instruction *slot = &decodeCache[physPage * PageSize / 4];
+    for (unsigned int i = 0; i < PageSize / 4; i++)
+	slot[i].opCode = 0;
+    if (blockEngine != NULL)
+	blockEngine->InvalidateFrame(physPage);
+}
+
 //----------------------------------------------------------------------
 // Machine::RaiseException
 // 	Transfer control to the Nachos kernel from user mode, because
@@ -100,10 +225,17 @@ Machine::~Machine()
 void
 Machine::RaiseException(ExceptionType which, int badVAddr)
 {
+    if (shadow) {
+	shadowStopped = TRUE;		// the real machine will run this
+	return;				// instruction again, and trap
+    }
     DEBUG(dbgMach, "Exception: " << exceptionNames[which]);
     
+    FlushTicks();			// the kernel must see the right time
     registers[BadVAddrReg] = badVAddr;
     DelayedLoad(0, 0);			// finish anything in progress
+    if (blockEngine != NULL)
+	blockEngine->Interrupted();	// the kernel may change anything
     kernel->interrupt->setStatus(SystemMode);
 //	cout << "entering system mode...\n";
     ExceptionHandler(which);		// interrupts are enabled at this point
@@ -111,6 +243,74 @@ Machine::RaiseException(ExceptionType which, int badVAddr)
 //	cout << "entering user mode...\n";
 }
 
+//----------------------------------------------------------------------
+// Machine::FlushTicks
+// 	Add the ticks of the instructions counted so far in this batch to
+//	the statistics, and end the batch, so that the next instruction
+//	goes through OneTick.  Called whenever the kernel is entered: it
+//	may look at the time, and may schedule interrupts that make the
+//	batch too long.
+//
+//	Both quietTicks and batchedTicks are 0 whenever a thread switch
+//	can happen (in the kernel, or in OneTick), so threads can share
+//	them.
+//----------------------------------------------------------------------
+
+void
+Machine::FlushTicks()
+{
+    if (batchedTicks > 0) {
+	kernel->interrupt->AdvanceUserTicks(batchedTicks);
+	batchedTicks = 0;
+    }
+    quietTicks = 0;
+}
+
+//----------------------------------------------------------------------
+// Machine::EndTickBatch
+// 	The current batch is used up: account for it, do the OneTick of
+//	this instruction (which may fire interrupts and switch threads),
+//	and work out how long the next batch may be.
+//----------------------------------------------------------------------
+
+void
+Machine::EndTickBatch()
+{
+    FlushTicks();
+    if (parallel != NULL)
+	parallel->RunWindow();		// let the other processors catch up
+    kernel->interrupt->OneTick();
+    if (batchTicks && !singleStep)
+	quietTicks = kernel->interrupt->QuietUserTicks();
+}
+
+//----------------------------------------------------------------------
+// Machine::RunShadow
+// 	In a shadow machine, run up to "limit" instructions of the user
+//	program whose registers and page table have been loaded.  We
+//	stop early at the first instruction that would raise an
+//	exception, leaving it (and the registers) as they were before
+//	it, for the real machine to run and trap on.
+//
+//	Returns how many instructions completed.
+//----------------------------------------------------------------------
+
+int
+Machine::RunShadow(int limit)
+{
+    int ran = 0;
+
+    ASSERT(shadow);
+    shadowStopped = FALSE;
+    while (ran < limit) {
+	OneInstruction();
+	if (shadowStopped)
+	    break;
+	ran++;
+    }
+    return ran;
+}
+
 //----------------------------------------------------------------------
 // Machine::Debugger
 // 	Primitive debugger for user programs.  Note that we can't use
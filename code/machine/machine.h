@@ -82,13 +82,71 @@ enum ExceptionType { NoException,           // Everything ok!
 // The procedures in this class are defined in machine.cc, mipssim.cc, and
 // translate.cc.
 
-class Instruction;
+// The following class defines an instruction, represented in both
+// 	undecoded binary form
+//      decoded to identify
+//	    operation to do
+//	    registers to act on
+//	    any immediate operand value
+
+class Instruction {
+  public:
+    void Decode();	// decode the binary representation of the instruction
+
+    unsigned int value; // binary representation of the instruction
+
+    char opCode;     // Type of instruction.  This is NOT the same as the
+    		     // opcode field from the instruction: see defs in mips.h
+		     // 0 is never produced by Decode(), so a zero opCode
+		     // marks an empty slot in the decode cache.
+    unsigned char rs, rt, rd; // Three registers from instruction.
+    int extra;       // Immediate or target or shamt field or offset.
+                     // Immediates are sign-extended.
+};
+
+// The effects of an instruction that only become visible once it has
+// completed without raising an exception.
+
+struct ExecState {
+    int pcAfter;	// PC to use after the delay slot
+    int loadReg;	// register target of a new delayed load (0 if none)
+    int loadValue;	// the value that load will deliver
+};
+
+// One slot of the simulator's own translation cache.  This is not the
+// MIPS TLB -- user programs and the kernel can't see it -- just a way of
+// skipping Translate on the common path.  A slot remembers where a
+// virtual page of one address space (identified by its page table) lives
+// in mainMemory, separately for reads and writes: "writeBase" is only
+// filled in once the page has been written through Translate, which is
+// also what sets its dirty bit.
+
+class TransCacheEntry {
+  public:
+    TranslationEntry *pageTable;	// address space the slot is for
+    unsigned int vpn;			// virtual page number
+    TranslationEntry *entry;		// its page table entry
+    char *readBase;			// page in mainMemory, or NULL
+    char *writeBase;			// same, if writes may go straight
+					// there; otherwise NULL
+};
+
+const int TransCacheSize = 64;		// slots; must be a power of two
+
 class Interrupt;
+class BlockEngine;
+class ParallelRunner;
 
 class Machine {
   public:
-    Machine(bool debug);	// Initialize the simulation of the hardware
-				// for running user programs
+    Machine(bool debug, bool useBlocks = FALSE, int hotThreshold = 0,
+	    int blockCacheSize = 0, bool hostParallel = FALSE);
+				// Initialize the simulation of the hardware
+				// for running user programs; "useBlocks"
+				// selects the basic-block engine, 0 picks
+				// its default settings; "hostParallel" runs
+				// the processors of a multiprocessor on
+				// host threads
     ~Machine();			// De-allocate the data structures
 
 // Routines callable by the Nachos kernel
@@ -132,14 +190,41 @@ class Machine {
     TranslationEntry *pageTable;
     unsigned int pageTableSize;
     bool ReadMem(int addr, int size, int* value);
+
+    void PageTableChanged();	// The kernel has installed a page table,
+				// or may have changed the one in use;
+				// call on every context switch
+
+    void InvalidateTranslation(TranslationEntry *entry);
+				// A page table entry has been made invalid,
+				// or its use or dirty bit cleared
+    void FlushTranslations();	// A page table is being created or freed
+
+    void InvalidateDecodeCache(int physPage);
+				// Forget the decoded instructions of a
+				// physical page, because the kernel is 
+				// about to overwrite its contents
   private:
+    Machine(Machine *real);	// A shadow of "real", sharing its memory,
+				// to run one processor's user code on a
+				// host thread (see parallel.h)
 
 // Routines internal to the machine simulation -- DO NOT call these directly
     void DelayedLoad(int nextReg, int nextVal);  	
 				// Do a pending delayed load (modifying a reg)
 
-    void OneInstruction(Instruction *instr); 	
-    				// Run one instruction of a user program.
+    void OneInstruction(); 	// Run one instruction of a user program.
+
+    Instruction *DecodeAt(int physAddr);
+    				// Decoded instruction at a physical address
+
+    typedef bool (Machine::*OpHandler)(Instruction *instr, ExecState *state);
+    template <int op>
+    bool ExecuteOp(Instruction *instr, ExecState *state);
+    				// Carry out one decoded instruction; 
+				// FALSE if it raised an exception
+    static const OpHandler opHandlers[];
+				// ExecuteOp for each opCode
     
 //    bool ReadMem(int addr, int size, int* value);
     bool WriteMem(int addr, int size, int value);
@@ -154,10 +239,33 @@ class Machine {
     				// and return an exception code if the 
 				// translation couldn't be completed.
 
+    char *CachedTranslation(int virtAddr, bool writing);
+				// Host address of a virtual address, if
+				// the translation cache can supply it
+    ExceptionType TranslateCached(int virtAddr, int* physAddr, int size,
+				  bool writing);
+				// Translate, trying the translation
+				// cache first and filling it on a miss
+    void FillTranslation(int virtAddr, int physAddr, bool writing);
+				// Remember a successful translation
+
+    void TouchPage(TranslationEntry *entry);
+				// Record a read reference to a page whose
+				// translation is already known to be good
+
     void RaiseException(ExceptionType which, int badVAddr);
 				// Trap to the Nachos kernel, because of a
 				// system call or other exception.  
 
+    void Tick();		// Account for one user instruction; same
+				// as Interrupt::OneTick, but in batches
+    void EndTickBatch();	// Account for the batched ticks, then do
+				// a full OneTick and start a new batch
+    void FlushTicks();		// Account for the batched ticks only
+
+    int RunShadow(int limit);	// In a shadow, run up to "limit" user
+				// instructions; returns how many completed
+
     void Debugger();		// invoke the user program debugger
     void DumpState();		// print the user CPU and memory state 
 
@@ -166,14 +274,118 @@ class Machine {
 
     int registers[NumTotalRegs]; // CPU registers, for executing user programs
 
+    Instruction *decodeCache;	// one pre-decoded instruction per word of
+				// mainMemory, filled the first time the
+				// word is executed and cleared whenever
+				// the word is written
+
+    TransCacheEntry transCache[TransCacheSize];
+				// direct-mapped by virtual page number
+    bool useTransCache;		// FALSE if there is a hardware TLB, or
+				// address tracing ('a') is on, which
+				// expects every access to be translated
+    bool touchOnHit;		// the replacement algorithm wants to
+				// hear about every reference (LRU)
+
+    BlockEngine *blockEngine;	// if non-NULL, runs user code a basic
+				// block at a time instead of OneInstruction
+
+    ParallelRunner *parallel;	// if non-NULL, runs the user code of all
+				// the processors on host threads, between
+				// interrupts
+    bool shadow;		// TRUE if we only run user code for a
+				// ParallelRunner: an exception just stops
+				// us, and the real machine takes it
+    bool shadowStopped;		// a shadow has hit an exception
+    bool *codeWritten;		// in a shadow, the frames in which it has
+				// overwritten decoded instructions, for
+				// the real machine's BlockEngine to forget
+
+    bool batchTicks;		// FALSE if every tick must go through
+				// OneTick (debugging output is on)
+    int quietTicks;		// instructions left in this batch, before
+				// an interrupt could be due
+    int batchedTicks;		// instructions run in this batch so far
+
     bool singleStep;		// drop back into the debugger after each
 				// simulated instruction
     int runUntilTime;		// drop back into the debugger when simulated
 				// time reaches this value
 
  friend class Interrupt;		// calls DelayedLoad()    
+ friend class BlockEngine;	// runs instructions on our behalf
+ friend class BlockCompiler;	// and translates them to run natively
+ friend class ParallelRunner;	// so does each shadow, on a host thread
 };
 
+//----------------------------------------------------------------------
+// Machine::CachedTranslation
+// 	Look "virtAddr" up in the translation cache.  On a hit, return
+//	where it lives in mainMemory; the page's use (and, for a write,
+//	dirty) bit is already set, since it was set when the slot was
+//	filled and clearing either one invalidates the slot.  Returns
+//	NULL on a miss, in which case the caller must go through Translate.
+//
+//	Defined here so ReadMem, WriteMem and the instruction fetch can
+//	inline it.
+//----------------------------------------------------------------------
+
+inline char *
+Machine::CachedTranslation(int virtAddr, bool writing)
+{
+    unsigned int vpn = (unsigned) virtAddr / PageSize;
+    TransCacheEntry *slot = &transCache[vpn & (TransCacheSize - 1)];
+    char *base = writing ? slot->writeBase : slot->readBase;
+
+    if (base == NULL || slot->vpn != vpn || slot->pageTable != pageTable)
+	return NULL;
+    if (touchOnHit)
+	TouchPage(slot->entry);
+    return base + (unsigned) virtAddr % PageSize;
+}
+
+//----------------------------------------------------------------------
+// Machine::Tick
+// 	Called after each user instruction in place of
+//	Interrupt::OneTick.  While no interrupt can be due, just count
+//	the instruction; the ticks are added to the statistics in one go
+//	when the batch ends, or when the kernel is entered.
+//----------------------------------------------------------------------
+
+inline void
+Machine::Tick()
+{
+    if (quietTicks > 0) {
+	quietTicks--;
+	batchedTicks++;
+    } else
+	EndTickBatch();
+}
+
+//----------------------------------------------------------------------
+// Machine::TranslateCached
+// 	Same interface as Translate.  Accesses that hit in the translation
+//	cache skip Translate entirely; the others are translated as usual
+//	and the result remembered for next time.
+//----------------------------------------------------------------------
+
+inline ExceptionType
+Machine::TranslateCached(int virtAddr, int* physAddr, int size, bool writing)
+{
+    ExceptionType exception;
+    char *host;
+
+    if ((virtAddr & (size - 1)) == 0 
+		&& (host = CachedTranslation(virtAddr, writing)) != NULL) {
+	*physAddr = host - mainMemory;
+	return NoException;
+    }
+    exception = Translate(virtAddr, physAddr, size, writing);
+    if (exception == NoException && useTransCache)
+	FillTranslation(virtAddr, *physAddr, writing);
+    return exception;
+}
+
 extern void ExceptionHandler(ExceptionType which);
 				// Entry point into Nachos for handling
 				// user system calls and exceptions
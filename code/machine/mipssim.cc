@@ -15,30 +15,11 @@
 #include "debug.h"
 #include "machine.h"
 #include "mipssim.h"
+#include "blockengine.h"
 #include "main.h"
 
 static void Mult(int a, int b, bool signedArith, int* hiPtr, int* loPtr);
 
-// The following class defines an instruction, represented in both
-// 	undecoded binary form
-//      decoded to identify
-//	    operation to do
-//	    registers to act on
-//	    any immediate operand value
-
-class Instruction {
-  public:
-    void Decode();	// decode the binary representation of the instruction
-
-    unsigned int value; // binary representation of the instruction
-
-    char opCode;     // Type of instruction.  This is NOT the same as the
-    		     // opcode field from the instruction: see defs in mips.h
-    char rs, rt, rd; // Three registers from instruction.
-    int extra;       // Immediate or target or shamt field or offset.
-                     // Immediates are sign-extended.
-};
-
 //----------------------------------------------------------------------
 // Machine::Run
 // 	Simulate the execution of a user-level program on Nachos.
@@ -51,16 +32,16 @@ class Instruction {
 void
 Machine::Run()
 {
-    Instruction *instr = new Instruction;  // storage for decoded instruction
-
     if (debug->IsEnabled('m')) {
         cout << "Starting program in thread: " << kernel->currentThread->getName();
 	cout << ", at time: " << kernel->stats->totalTicks << "\n";
     }
     kernel->interrupt->setStatus(UserMode);
+    if (blockEngine != NULL)
+	blockEngine->Run();	// never returns
     for (;;) {
-        OneInstruction(instr);
-	kernel->interrupt->OneTick();
+        OneInstruction();
+	Tick();
 	if (singleStep && (runUntilTime <= kernel->stats->totalTicks))
 	  Debugger();
     }
@@ -110,21 +91,32 @@ TypeToReg(RegType reg, Instruction *instr)
 //	leaving.  This allows the Nachos kernel to control our behavior
 //	by controlling the contents of memory, the translation table,
 //	and the register set.
+//
+//	The one thing we do keep around is the decoded form of each
+//	instruction word, in "decodeCache" (indexed by physical address).
+//	The fetch is still translated every time, so page faults and the
+//	use bits behave exactly as before; only the decode is skipped.
+//	Anything that changes a word of mainMemory clears its slot.
 //----------------------------------------------------------------------
 
 void
-Machine::OneInstruction(Instruction *instr)
+Machine::OneInstruction()
 {
-    int raw;
-    int nextLoadReg = 0; 	
-    int nextLoadValue = 0; 	// record delayed load operation, to apply
-				// in the future
+    Instruction *instr;
+    ExceptionType exception;
+    int physAddr;
+    ExecState state;		// where to go next, and the delayed load
+				// operation to apply in the future
 
     // Fetch instruction 
-    if (!ReadMem(registers[PCReg], 4, &raw))
+    DEBUG(dbgAddr, "Reading VA " << registers[PCReg] << ", size 4");
+    exception = TranslateCached(registers[PCReg], &physAddr, 4, FALSE);
+    if (exception != NoException) {
+	RaiseException(exception, registers[PCReg]);
 	return;			// exception occurred
-    instr->value = raw;
-    instr->Decode();
+    }
+    instr = DecodeAt(physAddr);
+    DEBUG(dbgAddr, "\tvalue read = " << (int) instr->value);
 
     if (debug->IsEnabled('m')) {
         struct OpString *str = &opStrings[instr->opCode];
@@ -138,19 +130,62 @@ Machine::OneInstruction(Instruction *instr)
     }
     
     // Compute next pc, but don't install in case there's an error or branch.
-    int pcAfter = registers[NextPCReg] + 4;
+    state.pcAfter = registers[NextPCReg] + 4;
+    state.loadReg = 0;
+    state.loadValue = 0;
+
+    // Execute the instruction (cf. Kane's book)
+    if (!(this->*opHandlers[(int) instr->opCode])(instr, &state))
+	return;			// exception occurred
+
+    // Now we have successfully executed the instruction.
+    
+    // Do any delayed load operation
+    DelayedLoad(state.loadReg, state.loadValue);
+    
+    // Advance program counters.
+    registers[PrevPCReg] = registers[PCReg];	// for debugging, in case we
+						// are jumping into lala-land
+    registers[PCReg] = registers[NextPCReg];
+    registers[NextPCReg] = state.pcAfter;
+}
+
+//----------------------------------------------------------------------
+// Machine::ExecuteOp
+// 	Carry out the operation of one decoded instruction.  There is
+//	one instantiation per opcode, so the switch below collapses to
+//	the single case for "op"; opHandlers[] collects them into a
+//	table indexed by opCode.
+//
+//	Changes that only take effect once the instruction has completed
+//	(the branch target and the delayed load) are returned in "state"
+//	rather than applied here, so the caller can finish the instruction
+//	the same way whether it came from OneInstruction or a translated
+//	basic block.
+//
+//	Returns FALSE if the instruction raised an exception; the kernel
+//	has already been invoked in that case.
+//
+//	"instr" -- the decoded instruction
+//	"state" -- pcAfter must be set up by the caller, to the PC that
+//		follows the delay slot if no branch is taken
+//----------------------------------------------------------------------
+
+template <int op>
+bool
+Machine::ExecuteOp(Instruction *instr, ExecState *state)
+{
     int sum, diff, tmp, value;
     unsigned int rs, rt, imm;
 
-    // Execute the instruction (cf. Kane's book)
-    switch (instr->opCode) {
+    switch (op) {
 	
       case OP_ADD:
 	sum = registers[instr->rs] + registers[instr->rt];
 	if (!((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
 	    ((registers[instr->rs] ^ sum) & SIGN_BIT)) {
 	    RaiseException(OverflowException, 0);
-	    return;
+	    return FALSE;
 	}
 	registers[instr->rd] = sum;
 	break;
@@ -160,7 +195,7 @@ Machine::OneInstruction(Instruction *instr)
 	if (!((registers[instr->rs] ^ instr->extra) & SIGN_BIT) &&
 	    ((instr->extra ^ sum) & SIGN_BIT)) {
 	    RaiseException(OverflowException, 0);
-	    return;
+	    return FALSE;
 	}
 	registers[instr->rt] = sum;
 	break;
@@ -183,36 +218,36 @@ Machine::OneInstruction(Instruction *instr)
 	
       case OP_BEQ:
 	if (registers[instr->rs] == registers[instr->rt])
-	    pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
+	    state->pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
 	break;
 	
       case OP_BGEZAL:
 	registers[R31] = registers[NextPCReg] + 4;
       case OP_BGEZ:
 	if (!(registers[instr->rs] & SIGN_BIT))
-	    pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
+	    state->pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
 	break;
 	
       case OP_BGTZ:
 	if (registers[instr->rs] > 0)
-	    pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
+	    state->pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
 	break;
 	
       case OP_BLEZ:
 	if (registers[instr->rs] <= 0)
-	    pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
+	    state->pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
 	break;
 	
       case OP_BLTZAL:
 	registers[R31] = registers[NextPCReg] + 4;
       case OP_BLTZ:
 	if (registers[instr->rs] & SIGN_BIT)
-	    pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
+	    state->pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
 	break;
 	
       case OP_BNE:
 	if (registers[instr->rs] != registers[instr->rt])
-	    pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
+	    state->pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
 	break;
 	
       case OP_DIV:
@@ -242,27 +277,27 @@ Machine::OneInstruction(Instruction *instr)
       case OP_JAL:
 	registers[R31] = registers[NextPCReg] + 4;
       case OP_J:
-	pcAfter = (pcAfter & 0xf0000000) | IndexToAddr(instr->extra);
+	state->pcAfter = (state->pcAfter & 0xf0000000) | IndexToAddr(instr->extra);
 	break;
 	
       case OP_JALR:
 	registers[instr->rd] = registers[NextPCReg] + 4;
       case OP_JR:
-	pcAfter = registers[instr->rs];
+	state->pcAfter = registers[instr->rs];
 	break;
 	
       case OP_LB:
       case OP_LBU:
 	tmp = registers[instr->rs] + instr->extra;
 	if (!ReadMem(tmp, 1, &value))
-	    return;
+	    return FALSE;
 
 	if ((value & 0x80) && (instr->opCode == OP_LB))
 	    value |= 0xffffff00;
 	else
 	    value &= 0xff;
-	nextLoadReg = instr->rt;
-	nextLoadValue = value;
+	state->loadReg = instr->rt;
+	state->loadValue = value;
 	break;
 	
       case OP_LH:
@@ -270,17 +305,17 @@ Machine::OneInstruction(Instruction *instr)
 	tmp = registers[instr->rs] + instr->extra;
 	if (tmp & 0x1) {
 	    RaiseException(AddressErrorException, tmp);
-	    return;
+	    return FALSE;
 	}
 	if (!ReadMem(tmp, 2, &value))
-	    return;
+	    return FALSE;
 
 	if ((value & 0x8000) && (instr->opCode == OP_LH))
 	    value |= 0xffff0000;
 	else
 	    value &= 0xffff;
-	nextLoadReg = instr->rt;
-	nextLoadValue = value;
+	state->loadReg = instr->rt;
+	state->loadValue = value;
 	break;
       	
       case OP_LUI:
@@ -292,12 +327,12 @@ Machine::OneInstruction(Instruction *instr)
 	tmp = registers[instr->rs] + instr->extra;
 	if (tmp & 0x3) {
 	    RaiseException(AddressErrorException, tmp);
-	    return;
+	    return FALSE;
 	}
 	if (!ReadMem(tmp, 4, &value))
-	    return;
-	nextLoadReg = instr->rt;
-	nextLoadValue = value;
+	    return FALSE;
+	state->loadReg = instr->rt;
+	state->loadValue = value;
 	break;
     	
       case OP_LWL:	  
@@ -309,26 +344,26 @@ Machine::OneInstruction(Instruction *instr)
 	ASSERT((tmp & 0x3) == 0);  
 
 	if (!ReadMem(tmp, 4, &value))
-	    return;
+	    return FALSE;
 	if (registers[LoadReg] == instr->rt)
-	    nextLoadValue = registers[LoadValueReg];
+	    state->loadValue = registers[LoadValueReg];
 	else
-	    nextLoadValue = registers[instr->rt];
+	    state->loadValue = registers[instr->rt];
 	switch (tmp & 0x3) {
 	  case 0:
-	    nextLoadValue = value;
+	    state->loadValue = value;
 	    break;
 	  case 1:
-	    nextLoadValue = (nextLoadValue & 0xff) | (value << 8);
+	    state->loadValue = (state->loadValue & 0xff) | (value << 8);
 	    break;
 	  case 2:
-	    nextLoadValue = (nextLoadValue & 0xffff) | (value << 16);
+	    state->loadValue = (state->loadValue & 0xffff) | (value << 16);
 	    break;
 	  case 3:
-	    nextLoadValue = (nextLoadValue & 0xffffff) | (value << 24);
+	    state->loadValue = (state->loadValue & 0xffffff) | (value << 24);
 	    break;
 	}
-	nextLoadReg = instr->rt;
+	state->loadReg = instr->rt;
 	break;
       	
       case OP_LWR:
@@ -340,29 +375,29 @@ Machine::OneInstruction(Instruction *instr)
 	ASSERT((tmp & 0x3) == 0);  
 
 	if (!ReadMem(tmp, 4, &value))
-	    return;
+	    return FALSE;
 	if (registers[LoadReg] == instr->rt)
-	    nextLoadValue = registers[LoadValueReg];
+	    state->loadValue = registers[LoadValueReg];
 	else
-	    nextLoadValue = registers[instr->rt];
+	    state->loadValue = registers[instr->rt];
 	switch (tmp & 0x3) {
 	  case 0:
-	    nextLoadValue = (nextLoadValue & 0xffffff00) |
+	    state->loadValue = (state->loadValue & 0xffffff00) |
 		((value >> 24) & 0xff);
 	    break;
 	  case 1:
-	    nextLoadValue = (nextLoadValue & 0xffff0000) |
+	    state->loadValue = (state->loadValue & 0xffff0000) |
 		((value >> 16) & 0xffff);
 	    break;
 	  case 2:
-	    nextLoadValue = (nextLoadValue & 0xff000000)
+	    state->loadValue = (state->loadValue & 0xff000000)
 		| ((value >> 8) & 0xffffff);
 	    break;
 	  case 3:
-	    nextLoadValue = value;
+	    state->loadValue = value;
 	    break;
 	}
-	nextLoadReg = instr->rt;
+	state->loadReg = instr->rt;
 	break;
     	
       case OP_MFHI:
@@ -406,13 +441,13 @@ Machine::OneInstruction(Instruction *instr)
       case OP_SB:
 	if (!WriteMem((unsigned) 
 		(registers[instr->rs] + instr->extra), 1, registers[instr->rt]))
-	    return;
+	    return FALSE;
 	break;
 	
       case OP_SH:
 	if (!WriteMem((unsigned) 
 		(registers[instr->rs] + instr->extra), 2, registers[instr->rt]))
-	    return;
+	    return FALSE;
 	break;
 	
       case OP_SLL:
@@ -482,7 +517,7 @@ Machine::OneInstruction(Instruction *instr)
 	if (((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
 	    ((registers[instr->rs] ^ diff) & SIGN_BIT)) {
 	    RaiseException(OverflowException, 0);
-	    return;
+	    return FALSE;
 	}
 	registers[instr->rd] = diff;
 	break;
@@ -494,7 +529,7 @@ Machine::OneInstruction(Instruction *instr)
       case OP_SW:
 	if (!WriteMem((unsigned) 
 		(registers[instr->rs] + instr->extra), 4, registers[instr->rt]))
-	    return;
+	    return FALSE;
 	break;
 	
       case OP_SWL:	  
@@ -505,7 +540,7 @@ Machine::OneInstruction(Instruction *instr)
 	ASSERT((tmp & 0x3) == 0);  
 
 	if (!ReadMem((tmp & ~0x3), 4, &value))
-	    return;
+	    return FALSE;
 	switch (tmp & 0x3) {
 	  case 0:
 	    value = registers[instr->rt];
@@ -524,7 +559,7 @@ Machine::OneInstruction(Instruction *instr)
 	    break;
 	}
 	if (!WriteMem((tmp & ~0x3), 4, value))
-	    return;
+	    return FALSE;
 	break;
     	
       case OP_SWR:	  
@@ -535,7 +570,7 @@ Machine::OneInstruction(Instruction *instr)
 	ASSERT((tmp & 0x3) == 0);  
 
 	if (!ReadMem((tmp & ~0x3), 4, &value))
-	    return;
+	    return FALSE;
 	switch (tmp & 0x3) {
 	  case 0:
 	    value = (value & 0xffffff) | (registers[instr->rt] << 24);
@@ -551,11 +586,13 @@ Machine::OneInstruction(Instruction *instr)
 	    break;
 	}
 	if (!WriteMem((tmp & ~0x3), 4, value))
-	    return;
+	    return FALSE;
 	break;
     	
       case OP_SYSCALL:
 	RaiseException(SyscallException, 0);
+	if (shadow)
+	    return FALSE;	// not run yet: the real machine will do it
 //	return; 
 	break;
 	
@@ -570,22 +607,47 @@ Machine::OneInstruction(Instruction *instr)
       case OP_RES:
       case OP_UNIMP:
 	RaiseException(IllegalInstrException, 0);
-	return;
+	return FALSE;
 	
       default:
 	ASSERT(FALSE);
     }
-    
-    // Now we have successfully executed the instruction.
-    
-    // Do any delayed load operation
-    DelayedLoad(nextLoadReg, nextLoadValue);
-    
-    // Advance program counters.
-    registers[PrevPCReg] = registers[PCReg];	// for debugging, in case we
-						// are jumping into lala-land
-    registers[PCReg] = registers[NextPCReg];
-    registers[NextPCReg] = pcAfter;
+    return TRUE;
+}
+
+// The handler for each opCode.  Slots that Decode() never produces
+// fall into the default case of ExecuteOp and assert.
+
+#define OP_HANDLERS_8(n) \
+    &Machine::ExecuteOp<n>,     &Machine::ExecuteOp<n + 1>, \
+    &Machine::ExecuteOp<n + 2>, &Machine::ExecuteOp<n + 3>, \
+    &Machine::ExecuteOp<n + 4>, &Machine::ExecuteOp<n + 5>, \
+    &Machine::ExecuteOp<n + 6>, &Machine::ExecuteOp<n + 7>
+
+const Machine::OpHandler Machine::opHandlers[MaxOpcode + 1] = {
+    OP_HANDLERS_8(0),  OP_HANDLERS_8(8),  OP_HANDLERS_8(16), OP_HANDLERS_8(24),
+    OP_HANDLERS_8(32), OP_HANDLERS_8(40), OP_HANDLERS_8(48), OP_HANDLERS_8(56)
+};
+
+#undef OP_HANDLERS_8
+
+//----------------------------------------------------------------------
+// Machine::DecodeAt
+// 	Return the decoded form of the instruction word at physical
+//	address "physAddr", decoding it into the decode cache the first
+//	time the word is executed.
+//----------------------------------------------------------------------
+
+Instruction *
+Machine::DecodeAt(int physAddr)
+{
+    Instruction *instr = &decodeCache[physAddr / 4];
+
+    if (instr->opCode == 0) {
+	instr->value = WordToHost(*(unsigned int *) &mainMemory[physAddr]);
+	instr->Decode();
+    }
+    return instr;
 }
 
 //----------------------------------------------------------------------
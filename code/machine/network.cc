@@ -31,8 +31,8 @@ NetworkInput::NetworkInput(CallBackObj *toCall)
     AssignNameToSocket(sockName, sock);		 // Bind socket to a filename 
 						 // in the current directory.
 
-    // start polling for incoming packets
-    kernel->interrupt->Schedule(this, NetworkTime, NetworkRecvInt);
+    // wait for incoming packets
+    kernel->interrupt->WatchInput(sock, this, NetworkTime, NetworkRecvInt);
 }
 
 //-----------------------------------------------------------------------
@@ -60,13 +60,12 @@ NetworkInput::~NetworkInput()
 void
 NetworkInput::CallBack()
 {
-    // schedule the next time to poll for a packet
-    kernel->interrupt->Schedule(this, NetworkTime, NetworkRecvInt);
-
     if (inHdr.length != 0) 	// do nothing if packet is already buffered
-	return;		
-    if (!PollSocket(sock)) 	// do nothing if no packet to be read
+	return;			// (Receive will wait for the next one)
+    if (!PollSocket(sock)) {	// no packet to be read after all
+	kernel->interrupt->WatchInput(sock, this, NetworkTime, NetworkRecvInt);
 	return;
+    }
 
     // otherwise, read packet in
     char *buffer = new char[MaxWireSize];
@@ -98,6 +97,8 @@ NetworkInput::Receive(char* data)
     inHdr.length = 0;
     if (hdr.length != 0) {
     	bcopy(inbox, data, hdr.length);
+	// wait for the next packet
+	kernel->interrupt->WatchInput(sock, this, NetworkTime, NetworkRecvInt);
     }
     return hdr;
 }
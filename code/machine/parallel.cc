@@ -0,0 +1,245 @@
+// parallel.cc
+//	Routines to run the user code of a simulated multiprocessor on
+//	several host threads.  See parallel.h for when this is safe.
+//
+//	All of the kernel, and everything here but RunShadows, runs on
+//	the host thread that has always run Nachos.  The workers only
+//	touch their own shadow Machine, and the frames of the address
+//	space it is running, while that thread waits for them.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "parallel.h"
+#include "blockengine.h"
+#include "main.h"
+
+//----------------------------------------------------------------------
+// ParallelRunner::ParallelRunner
+// 	Make a shadow of "m" for each processor, and start a host thread
+//	to run it.  The threads wait until there is a window to run.
+//
+//	"m" is the real machine
+//	"numCpus" is the number of simulated processors
+//----------------------------------------------------------------------
+
+ParallelRunner::ParallelRunner(Machine *m, int numCpus)
+{
+    ASSERT(1 < numCpus && numCpus <= MaxCpus);
+
+    machine = m;
+    this->numCpus = numCpus;
+    hostCpu = 0;
+    generation = 0;
+    numBusy = 0;
+    exiting = FALSE;
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&startWindow, NULL);
+    pthread_cond_init(&windowDone, NULL);
+    for (int i = 0; i < numCpus; i++) {
+	shadows[i] = new Machine(m);
+	limits[i] = ran[i] = 0;
+	workers[i].runner = this;
+	workers[i].cpu = i;
+	if (pthread_create(&workers[i].thread, NULL, WorkerMain,
+						&workers[i]) != 0) {
+	    perror("pthread_create");
+	    ASSERT(FALSE);
+	}
+    }
+}
+
+//----------------------------------------------------------------------
+// ParallelRunner::~ParallelRunner
+// 	Tell the host threads to exit, wait for them, and free the
+//	shadows.
+//----------------------------------------------------------------------
+
+ParallelRunner::~ParallelRunner()
+{
+    pthread_mutex_lock(&mutex);
+    exiting = TRUE;
+    pthread_cond_broadcast(&startWindow);
+    pthread_mutex_unlock(&mutex);
+    for (int i = 0; i < numCpus; i++) {
+	pthread_join(workers[i].thread, NULL);
+	delete shadows[i];
+    }
+    pthread_cond_destroy(&windowDone);
+    pthread_cond_destroy(&startWindow);
+    pthread_mutex_destroy(&mutex);
+}
+
+//----------------------------------------------------------------------
+// ParallelRunner::WorkerMain
+// 	The procedure a host thread starts in; "arg" is its Worker.
+//----------------------------------------------------------------------
+
+void *
+ParallelRunner::WorkerMain(void *arg)
+{
+    Worker *worker = (Worker *) arg;
+
+    worker->runner->RunShadows(worker->cpu);
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// ParallelRunner::RunShadows
+// 	For each window, run processor "cpu" for as many instructions as
+//	it has been given, unless it sits the window out or the calling
+//	host thread is running it.  The last worker to finish wakes up
+//	the calling thread.
+//----------------------------------------------------------------------
+
+void
+ParallelRunner::RunShadows(int cpu)
+{
+    unsigned int seen = 0;	// last window we looked at
+
+    pthread_mutex_lock(&mutex);
+    for (;;) {
+	while (generation == seen && !exiting)
+	    pthread_cond_wait(&startWindow, &mutex);
+	if (exiting)
+	    break;
+	seen = generation;
+	if (cpu == hostCpu || limits[cpu] == 0)
+	    continue;
+	pthread_mutex_unlock(&mutex);
+	ran[cpu] = shadows[cpu]->RunShadow(limits[cpu]);
+	pthread_mutex_lock(&mutex);
+	if (--numBusy == 0)
+	    pthread_cond_signal(&windowDone);
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+//----------------------------------------------------------------------
+// ParallelRunner::RunWindow
+// 	Called by Machine::EndTickBatch on the current processor, just
+//	before the OneTick of the instruction it has run.  Work out how
+//	far the processors in user code can run before anything else
+//	could happen; if it is worth it, load each one's registers and
+//	page table into its shadow, run them all at once, and charge each
+//	processor for the instructions it ran.
+//
+//	A processor counts as being in user code if it was switched out
+//	in the middle of it (see Scheduler::SwitchCpu) and no IPI is
+//	waiting for it.  The current processor always is.
+//----------------------------------------------------------------------
+
+void
+ParallelRunner::RunWindow()
+{
+    Scheduler *scheduler = kernel->scheduler;
+    Interrupt *interrupt = kernel->interrupt;
+    int current = scheduler->CurrentCpu();
+    int end, next, clock, total, numRunning;
+    bool inUser[MaxCpus];
+    Thread *thread;
+
+    if (interrupt->IsIPIPending(current))
+	return;			// it will reschedule at this tick
+    if (scheduler->HasTasks())
+	return;			// they run at this tick
+
+// find the end of the window
+    end = scheduler->CpuClock(current) + MaxWindow;
+    next = interrupt->NextInterruptTime();
+    if (next >= 0 && next - 1 < end)
+	end = next - 1;
+    for (int i = 0; i < numCpus; i++) {
+	inUser[i] = (i == current) || (!scheduler->IsCpuIdle(i)
+			&& scheduler->IsCpuInUserMode(i)
+			&& !interrupt->IsIPIPending(i));
+	if (!inUser[i] && !scheduler->IsCpuIdle(i)
+				&& scheduler->CpuClock(i) < end)
+	    end = scheduler->CpuClock(i);
+    }
+
+// and how far each processor may go in it.  OneTick is about to
+// charge the current processor for the instruction it has just run.
+    total = numRunning = 0;
+    for (int i = 0; i < numCpus; i++) {
+	limits[i] = ran[i] = 0;
+	if (!inUser[i])
+	    continue;
+	clock = scheduler->CpuClock(i) + ((i == current) ? UserTick : 0);
+	if (end > clock) {
+	    limits[i] = (end - clock) / UserTick;
+	    total += limits[i];
+	    numRunning++;
+	}
+    }
+    if (numRunning < 2 || total < MinWindowInstructions)
+	return;
+
+// load the shadows, the current processor's first, while its
+// registers and page table are still in the machine
+    for (int i = current, n = 0; n < numCpus; i = (i + 1) % numCpus, n++) {
+	if (limits[i] == 0 && i != current)
+	    continue;
+	if (i != current) {
+	    thread = scheduler->CpuThread(i);
+	    ASSERT(thread->space != NULL);
+	    thread->RestoreUserState();
+	    thread->space->RestoreState();
+	}
+	for (int r = 0; r < NumTotalRegs; r++)
+	    shadows[i]->registers[r] = machine->registers[r];
+	shadows[i]->pageTable = machine->pageTable;
+	shadows[i]->pageTableSize = machine->pageTableSize;
+	shadows[i]->FlushTranslations();	// the kernel may have changed
+						// the page table since
+    }
+
+// run them
+    pthread_mutex_lock(&mutex);
+    hostCpu = current;
+    numBusy = numRunning - ((limits[current] > 0) ? 1 : 0);
+    generation++;
+    pthread_cond_broadcast(&startWindow);
+    pthread_mutex_unlock(&mutex);
+    if (limits[current] > 0)
+	ran[current] = shadows[current]->RunShadow(limits[current]);
+    pthread_mutex_lock(&mutex);
+    while (numBusy > 0)
+	pthread_cond_wait(&windowDone, &mutex);
+    pthread_mutex_unlock(&mutex);
+
+// forget any translated blocks whose code they wrote over
+    for (int i = 0; i < numCpus; i++) {
+	for (unsigned int f = 0; f < NumPhysPages; f++) {
+	    if (shadows[i]->codeWritten[f]) {
+		shadows[i]->codeWritten[f] = FALSE;
+		if (machine->blockEngine != NULL)
+		    machine->blockEngine->InvalidateFrame(f);
+	    }
+	}
+    }
+
+// and put back what they did, the current processor last
+    total = 0;
+    for (int i = (current + 1) % numCpus, n = 0; n < numCpus; 
+					i = (i + 1) % numCpus, n++) {
+	if (limits[i] == 0 && i != current)
+	    continue;
+	for (int r = 0; r < NumTotalRegs; r++)
+	    machine->registers[r] = shadows[i]->registers[r];
+	if (i != current)
+	    scheduler->CpuThread(i)->SaveUserState();
+	scheduler->ChargeCpu(i, ran[i] * UserTick);
+	total += ran[i];
+    }
+    kernel->currentThread->space->RestoreState();
+					// tells the machine its registers
+					// have changed under it
+    kernel->stats->userTicks += total * UserTick;
+    kernel->stats->numParallelWindows++;
+    kernel->stats->numParallelInstructions += total;
+    DEBUG(dbgThread, "Ran " << total << " instructions on " << numRunning
+	  << " processors in parallel, up to time " << end);
+}
@@ -0,0 +1,96 @@
+// parallel.h
+//	Data structures for running the user code of a simulated
+//	multiprocessor on several host threads at once.
+//
+//	Normally the simulation takes a tick on each busy processor in
+//	turn, all on one host thread (see Interrupt::OneTick).  Between
+//	interrupts, though, the processors running user code can't see
+//	each other: every address space has its own frames, and nothing
+//	but the kernel (an interrupt handler, a syscall, a page fault) can
+//	change what a user program sees.  So before each tick we look for
+//	a window of simulated time in which nothing can happen but user
+//	instructions, and run every processor's share of that window on
+//	its own host thread, each with a "shadow" Machine that shares
+//	main memory and the decode cache but has its own registers.
+//
+//	A window ends
+//	    -- just before the next pending interrupt is due;
+//	    -- where any busy processor that is in the kernel has got to,
+//		since from then on it might change something a user
+//		program can see (evict one of its pages, for instance).
+//	A processor leaves the window early at the first instruction
+//	that would raise an exception; the real machine runs that
+//	instruction again later, at the same simulated time, and takes
+//	the exception then.  Only user code ever runs in parallel -- the
+//	kernel still runs a tick at a time on one host thread, which
+//	acts as a big kernel lock, so none of the kernel's
+//	synchronization has to know about host threads.
+//
+//	Every instruction still takes one tick of its processor's clock,
+//	and windows never cross an interrupt, but the results are NOT
+//	always those of the serial simulation.  When one processor stops
+//	early at an exception at time t, the others run on to the end of
+//	the window; the kernel then handles the exception at time t, and
+//	may evict a page, or send an IPI to, a processor that has already
+//	run past t.  Serially, that processor would have faulted on the
+//	page, or been preempted, at t.  So page faults and preemptions
+//	(and whatever depends on them) can come at different times with
+//	and without host threads; the user programs still compute the
+//	same things, since they can't see each other's memory.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include "copyright.h"
+#include "machine.h"
+#include "interrupt.h"
+#include <pthread.h>
+
+const int MaxWindow = 100000;		// most ticks a window may span
+const int MinWindowInstructions = 64;	// below this, starting the host
+					// threads costs more than it saves
+
+class ParallelRunner {
+  public:
+    ParallelRunner(Machine *m, int numCpus);
+				// Start a host thread for each processor
+    ~ParallelRunner();		// Stop the host threads
+
+    void RunWindow();		// Called before each tick of the current
+				// processor: run every processor that is
+				// in user code as far as we safely can
+
+  private:
+    class Worker {
+      public:
+	ParallelRunner *runner;
+	int cpu;		// processor whose shadow it runs
+	pthread_t thread;
+    };
+
+    Machine *machine;		// the real machine
+    int numCpus;
+    Machine *shadows[MaxCpus];	// one per processor
+    Worker workers[MaxCpus];
+    int limits[MaxCpus];	// instructions each processor may run in
+				// this window; 0 if it sits this one out
+    int ran[MaxCpus];		// instructions each one did run
+    int hostCpu;		// processor run on the calling host thread
+
+    pthread_mutex_t mutex;	// protects the fields below
+    pthread_cond_t startWindow;	// signalled when a window starts
+    pthread_cond_t windowDone;	// signalled when the last worker is done
+    unsigned int generation;	// number of windows started
+    int numBusy;		// workers still running this window
+    bool exiting;		// TRUE if the workers should exit
+
+    static void *WorkerMain(void *arg);
+				// what each host thread runs
+    void RunShadows(int cpu);	// the body of a worker
+};
+
+#endif // PARALLEL_H
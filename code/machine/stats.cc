@@ -22,6 +22,17 @@ Statistics::Statistics()
     numDiskReads = numDiskWrites = 0;
     numConsoleCharsRead = numConsoleCharsWritten = 0;
     numPageFaults = numPacketsSent = numPacketsRecvd = 0;
+    numBlocksTranslated = numBlockFlushes = 0;
+    numPageOuts = numCleanPageOuts = 0;
+    pageoutLowWater = minFreeFrames = 0;
+    numPageoutWakeups = numPageoutWrites = numPageoutFrees = 0;
+    numThreadsFinished = totalWaitTicks = totalTurnaroundTicks = 0;
+    numIPIs = numCpuSwitches = 0;
+    numParallelWindows = numParallelInstructions = 0;
+    numSteals = numMigrations = 0;
+    numStacksAllocated = numStacksReused = 0;
+    maxStackUsed = 0;
+    numTaskSteps = 0;
 }
 
 //----------------------------------------------------------------------
@@ -39,7 +50,43 @@ Statistics::Print()
 		cout << ", writes " << numDiskWrites << "\n";
 		cout << "Console I/O: reads " << numConsoleCharsRead;
     cout << ", writes " << numConsoleCharsWritten << "\n";
-    cout << "Paging: faults " << numPageFaults << "\n";
+    cout << "Paging: faults " << numPageFaults;
+    cout << ", page outs " << numPageOuts;
+    cout << ", clean page outs skipped " << numCleanPageOuts << "\n";
+    if (pageoutLowWater > 0) {
+	cout << "Pageout: low water " << pageoutLowWater;
+	cout << ", min free frames " << minFreeFrames;
+	cout << ", wakeups " << numPageoutWakeups;
+	cout << ", writes " << numPageoutWrites;
+	cout << ", frames freed " << numPageoutFrees << "\n";
+    }
     cout << "Network I/O: packets received " << numPacketsRecvd;
 		cout << ", sent " << numPacketsSent << "\n";
+    if (numBlocksTranslated > 0) {
+	cout << "Blocks: translated " << numBlocksTranslated;
+	cout << ", cache flushes " << numBlockFlushes << "\n";
+    }
+    if (numCpuSwitches > 0) {
+	cout << "SMP: IPIs " << numIPIs;
+	cout << ", processor switches " << numCpuSwitches;
+	cout << ", steals " << numSteals << ", migrations " << numMigrations;
+	if (numParallelWindows > 0) {
+	    cout << ", parallel windows " << numParallelWindows;
+	    cout << " (" << numParallelInstructions << " instructions)";
+	}
+	cout << "\n";
+    }
+    if (numStacksAllocated > 0) {
+	cout << "Stacks: allocated " << numStacksAllocated;
+	cout << ", reused " << numStacksReused;
+	cout << ", deepest " << maxStackUsed << " words\n";
+    }
+    if (numTaskSteps > 0)
+	cout << "Tasks: steps " << numTaskSteps << "\n";
+    if (numThreadsFinished > 0) {
+	cout << "Scheduling: threads finished " << numThreadsFinished;
+	cout << ", average waiting " << totalWaitTicks / numThreadsFinished;
+	cout << ", average turnaround ";
+	cout << totalTurnaroundTicks / numThreadsFinished << "\n";
+    }
 }
@@ -33,8 +33,38 @@ class Statistics {
     int numConsoleCharsRead;	// number of characters read from the keyboard
     int numConsoleCharsWritten; // number of characters written to the display
     int numPageFaults;		// number of virtual memory page faults
+    int numPageOuts;		// number of pages written to swap
+    int numCleanPageOuts;	// number of swap writes skipped because
+				// the page was clean
+    int pageoutLowWater;	// free frames the pageout daemon keeps
+				// (0 if there is no daemon)
+    int minFreeFrames;		// fewest free frames there have been
+    int numPageoutWakeups;	// times the pageout daemon was woken
+    int numPageoutWrites;	// dirty pages it wrote back
+    int numPageoutFrees;	// clean pages it took away and freed
     int numPacketsSent;		// number of packets sent over the network
     int numPacketsRecvd;	// number of packets received over the network
+    int numBlocksTranslated;	// number of basic blocks translated (-bb)
+    int numBlockFlushes;	// number of times the block cache filled up
+    int numIPIs;		// inter-processor interrupts sent (-cpus)
+    int numCpuSwitches;		// times the simulation moved on to
+				// another processor
+    int numParallelWindows;	// times user code ran on host threads
+				// (-parallel)
+    int numParallelInstructions; // user instructions run that way
+    int numSteals;		// threads taken from another processor's
+				// ready queue
+    int numMigrations;		// times a thread ran on a different
+				// processor from the last time
+    int numStacksAllocated;	// thread stacks allocated from the host
+    int numStacksReused;	// thread stacks recycled (-stackpool)
+    int maxStackUsed;		// most words of stack a deleted thread
+				// had used
+    int numTaskSteps;		// steps taken by kernel tasks
+    int numThreadsFinished;	// number of threads that have finished
+    int totalWaitTicks;		// time they spent on the ready list
+    int totalTurnaroundTicks;	// time from when they were first made
+				// ready until they finished
 
     Statistics(); 		// initialize everything to zero
 
@@ -40,9 +40,24 @@ Timer::Timer(bool doRandom, CallBackObj *toCall)
     randomize = doRandom;
     callPeriodically = toCall;
     disable = FALSE;
+    scheduled = FALSE;
     SetInterrupt();
 }
 
+//----------------------------------------------------------------------
+// Timer::Enable
+//      Turn the timer back on after Disable.  If its last interrupt
+//	has already happened, start generating interrupts again.
+//----------------------------------------------------------------------
+
+void
+Timer::Enable()
+{
+    disable = FALSE;
+    if (!scheduled)
+	SetInterrupt();
+}
+
 //----------------------------------------------------------------------
 // Timer::CallBack
 //      Routine called when interrupt is generated by the hardware 
@@ -52,6 +67,8 @@ Timer::Timer(bool doRandom, CallBackObj *toCall)
 void 
 Timer::CallBack() 
 {
+    scheduled = FALSE;
+
     // invoke the Nachos interrupt handler for this device
     callPeriodically->CallBack();
     
@@ -77,5 +94,6 @@ Timer::SetInterrupt()
         }
        // schedule the next timer device interrupt
        kernel->interrupt->Schedule(this, delay, TimerInt);
+       scheduled = TRUE;
     }
 }
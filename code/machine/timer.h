@@ -35,12 +35,14 @@ class Timer : public CallBackObj {
     void Disable() { disable = TRUE; }
     				// Turn timer device off, so it doesn't
 				// generate any more interrupts.
+    void Enable();		// Turn it back on
 
   private:
     bool randomize;		// set if we need to use a random timeout delay
     CallBackObj *callPeriodically; // call this every TimerTicks time units 
     bool disable;		// turn off the timer device after next
     				// interrupt.
+    bool scheduled;		// is an interrupt on its way?
     
     void CallBack();		// called internally when the hardware
 				// timer generates an interrupt
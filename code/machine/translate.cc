@@ -31,6 +31,7 @@
 
 #include "copyright.h"
 #include "main.h"
+#include "blockengine.h"
 
 // Class TranslationEntry //////////////////////////////////////////////////
 
@@ -41,7 +42,7 @@ unsigned TranslationEntry::_EmptySector = 0;
 std::shared_ptr<SynchDisk> TranslationEntry::_SwapSpace;
 
 TranslationEntry::TranslationEntry() 
-    : virtualPage(-1), physicalPage(-1), valid(false), readOnly(false), use(false), dirty(false), m_has_swapped_out_before(false)
+    : virtualPage(-1), physicalPage(-1), valid(false), readOnly(false), use(false), dirty(false), m_backing(ZeroFill), m_space(nullptr)
 {
     if (_SwapSpace == nullptr) {
         char name[] = "SwapSpaceDisk";
@@ -76,25 +77,60 @@ TranslationEntry::~TranslationEntry()
 void TranslationEntry::SwapIn()
 {
     ASSERT(valid && 0 <= physicalPage && physicalPage < NumPhysPages);
-    const unsigned phys_offset = this->physicalPage * PageSize;
+    char* const frame = kernel->machine->mainMemory + this->physicalPage * PageSize;
+
+    // 這個frame的內容要換掉了，之前decode過的指令都不能用
+    kernel->machine->InvalidateDecodeCache(this->physicalPage);
 
-    if (!m_has_swapped_out_before) {
+    switch (m_backing) {
+    case ZeroFill:
         DEBUG(dbgMy, "SwapIn() - Fill physical page " << physicalPage << " with 0s");
-        memset(kernel->machine->mainMemory + phys_offset, 0, PageSize);
-    }
-    else {
+        memset(frame, 0, PageSize);
+        break;
+    case ExecFile:
+        DEBUG(dbgMy, "SwapIn() - Load virtual page " << virtualPage << " from executable into physical page " << physicalPage);
+        memset(frame, 0, PageSize);
+        m_space->ReadPageFromFile(virtualPage, frame);
+        break;
+    case SwapSector:
         DEBUG(dbgMy, "Swap into physical page: " << physicalPage);
 
         // 讀取sector並寫入mainMemory
-        _SwapSpace->ReadSector(this->m_sector_number, 
-                            kernel->machine->mainMemory + phys_offset);
+        _SwapSpace->ReadSector(this->m_sector_number, frame);
+        break;
     }
 }
 
+void TranslationEntry::SetFileBacked(AddrSpace *space)
+{
+    ASSERT(m_backing == ZeroFill && space != nullptr);
+    m_backing = ExecFile;
+    m_space = space;
+}
+
 
 void TranslationEntry::SwapOut()
 {
+    ASSERT(valid && 0 <= physicalPage && physicalPage < NumPhysPages);
+
+    /**
+     * 沒被修改過的page不用寫回：
+     * 1. swap out過的話，sector中的內容和memory一樣
+     * 2. 沒swap out過的話，下次swap in時會從原本的來源（執行檔或0）重新載入
+     */
+    if (!dirty) {
+        DEBUG(dbgMy, "Skip swapping out clean physical page: " << physicalPage);
+        kernel->stats->numCleanPageOuts++;
+        return;
+    }
+
     cout << "Swap out physical page: " << physicalPage << endl;
+    kernel->stats->numPageOuts++;
+    WriteBack();
+}
+
+void TranslationEntry::WriteBack()
+{
     ASSERT(valid && 0 <= physicalPage && physicalPage < NumPhysPages);
 
     const unsigned phys_offset = this->physicalPage * PageSize;
@@ -102,14 +138,7 @@ void TranslationEntry::SwapOut()
     _SwapSpace->WriteSector(this->m_sector_number, 
                           kernel->machine->mainMemory + phys_offset);
 
-    m_has_swapped_out_before = true;
-}
-
-void TranslationEntry::SwapOutData(char *data)
-{
-    DEBUG(dbgMy, "TranslationEntry::SwapOutData()");
-    _SwapSpace->WriteSector(this->m_sector_number, data);
-    m_has_swapped_out_before = true;
+    m_backing = SwapSector;
 }
 
 ////////////////////////////////////////////////////////////////////////////
@@ -173,7 +202,7 @@ Machine::ReadMem(int addr, int size, int *value)
     
     DEBUG(dbgAddr, "Reading VA " << addr << ", size " << size);
     
-    exception = Translate(addr, &physicalAddress, size, FALSE);
+    exception = TranslateCached(addr, &physicalAddress, size, FALSE);
     if (exception != NoException) {
 	RaiseException(exception, addr);
 	return FALSE;
@@ -222,7 +251,7 @@ Machine::WriteMem(int addr, int size, int value)
      
     DEBUG(dbgAddr, "Writing VA " << addr << ", size " << size << ", value " << value);
 
-    exception = Translate(addr, &physicalAddress, size, TRUE);
+    exception = TranslateCached(addr, &physicalAddress, size, TRUE);
     if (exception != NoException) {
 	RaiseException(exception, addr);
 	return FALSE;
@@ -244,6 +273,14 @@ Machine::WriteMem(int addr, int size, int value)
 
       default: ASSERT(FALSE);
     }
+    if (decodeCache[physicalAddress / 4].opCode != 0) {
+	// self-modifying code: forget what we decoded from this word
+	decodeCache[physicalAddress / 4].opCode = 0;
+	if (blockEngine != NULL)
+	    blockEngine->InvalidateFrame(physicalAddress / PageSize);
+	else if (shadow)	// the real machine's blocks, after the window
+	    codeWritten[physicalAddress / PageSize] = TRUE;
+    }
     
     return TRUE;
 }
@@ -296,6 +333,8 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
             DEBUG(dbgAddr, "Illegal virtual page # " << virtAddr);
             return AddressErrorException;
         } else if (!pageTable[vpn].valid) {
+                if (shadow)		// the real machine will take it
+                    return PageFaultException;
                 /* 		Add Page fault code here		*/
                 cout << "page fault occurs !!!!" << endl;
                 Page_Fault_Entry = &pageTable[vpn];
@@ -303,7 +342,7 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
         }
         entry = &pageTable[vpn];
 
-        if (algoType == "LRU")
+        if (touchOnHit)
             AddrSpace::LRU_Algo(entry);
 
     } else {
@@ -344,3 +383,81 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
     return NoException;
 }
 
+
+//----------------------------------------------------------------------
+// Machine::FillTranslation
+// 	Remember in the translation cache that "virtAddr" of the current
+//	address space was just translated, by Translate, to "physAddr".
+//	A read only makes the page readable through the cache; a write
+//	(which Translate has checked against readOnly, and which set the
+//	dirty bit) makes it writable as well.
+//----------------------------------------------------------------------
+
+void
+Machine::FillTranslation(int virtAddr, int physAddr, bool writing)
+{
+    unsigned int vpn = (unsigned) virtAddr / PageSize;
+    TransCacheEntry *slot = &transCache[vpn & (TransCacheSize - 1)];
+
+    if (slot->readBase == NULL || slot->vpn != vpn 
+				|| slot->pageTable != pageTable) {
+	slot->pageTable = pageTable;
+	slot->vpn = vpn;
+	slot->entry = &pageTable[vpn];
+	slot->writeBase = NULL;
+    }
+    slot->readBase = &mainMemory[(physAddr / PageSize) * PageSize];
+    if (writing)
+	slot->writeBase = slot->readBase;
+}
+
+//----------------------------------------------------------------------
+// Machine::InvalidateTranslation
+// 	Forget any cached translation that relies on "entry".  Must be
+//	called by the kernel whenever it clears the valid, use or dirty
+//	bit of a page table entry that might be in use, or changes its
+//	physical page.
+//----------------------------------------------------------------------
+
+void
+Machine::InvalidateTranslation(TranslationEntry *entry)
+{
+    TransCacheEntry *slot = 
+		&transCache[entry->virtualPage & (TransCacheSize - 1)];
+
+    if (slot->entry == entry)
+	slot->readBase = slot->writeBase = NULL;
+}
+
+//----------------------------------------------------------------------
+// Machine::FlushTranslations
+// 	Forget every cached translation.  Called when a page table is
+//	created or deleted, since a new page table may be allocated at
+//	the address of an old one.
+//----------------------------------------------------------------------
+
+void
+Machine::FlushTranslations()
+{
+    for (int i = 0; i < TransCacheSize; i++) {
+	transCache[i].readBase = transCache[i].writeBase = NULL;
+	transCache[i].entry = NULL;
+    }
+}
+
+//----------------------------------------------------------------------
+// Machine::TouchPage
+// 	Do the bookkeeping Translate does for a successful read of a page,
+//	for callers that already know the translation is valid: set the
+//	use bit, and tell the replacement algorithm about the reference.
+//
+//	"entry" -- the page table entry of the page referenced
+//----------------------------------------------------------------------
+
+void
+Machine::TouchPage(TranslationEntry *entry)
+{
+    if (touchOnHit)
+        AddrSpace::LRU_Algo(entry);
+    entry->use = TRUE;
+}
@@ -24,6 +24,7 @@
 #include <memory>
 
 class SynchDisk;
+class AddrSpace;
 
 // The following class defines an entry in a translation table -- either
 // in a page table or a TLB.  Each entry defines a mapping from one 
@@ -40,10 +41,15 @@ class TranslationEntry {
     void SwapIn();
 
     // from MainMemory to SwapSpace
+    // the write is skipped if the page is clean
     void SwapOut();
 
-    // from data to SwapSpace
-    void SwapOutData(char* data);
+    // from MainMemory to SwapSpace, even if the page is clean;
+    // the page stays in memory
+    void WriteBack();
+
+    /// 還沒swap out過的page，swap in時從 space 的執行檔讀取內容（預設是全部填0）
+    void SetFileBacked(AddrSpace* space);
 
     unsigned int virtualPage;  	// The page number in virtual memory.
     unsigned int physicalPage;  // The page number in real memory (relative to the
@@ -60,8 +66,15 @@ class TranslationEntry {
   private:
     /// @brief swap out時會將記憶體的內容暫存到哪個sector
     unsigned m_sector_number;
-    /// @brief 之前有沒有swap out過。沒有的話，swap in會放入0
-    bool m_has_swapped_out_before;
+    /// @brief swap in時page的內容從哪裡來
+    enum Backing {
+        ZeroFill,       ///< 全部填0（stack、uninitData）
+        ExecFile,       ///< 從執行檔讀取（code、initData），見 AddrSpace::ReadPageFromFile
+        SwapSector      ///< 之前swap out過，從m_sector_number讀取
+    };
+    Backing m_backing;
+    /// @brief m_backing為ExecFile時，page屬於哪個address space
+    AddrSpace* m_space;
 
     /// @brief 記錄sector是否被使用
     static std::bitset<1024> _IsSectorUsed;
@@ -18,6 +18,7 @@
 
 #include "copyright.h"
 #include "post.h"
+#include "main.h"
 
 //----------------------------------------------------------------------
 // Mail::Mail
@@ -43,13 +44,15 @@ Mail::Mail(PacketHeader pktH, MailHeader mailH, char *msgData)
 //      Initialize a single mail box within the post office, so that it
 //	can receive incoming messages.
 //
-//	Just initialize a list of messages, representing the mailbox.
+//	Just initialize a list of messages, representing the mailbox,
+//	and a semaphore to count them, for threads to wait on.
 //----------------------------------------------------------------------
 
 
 MailBox::MailBox()
 { 
-    messages = new SynchList<Mail *>(); 
+    messages = new List<Mail *>(); 
+    arrived = new Semaphore("mail arrived", 0);
 }
 
 //----------------------------------------------------------------------
@@ -63,6 +66,7 @@ MailBox::MailBox()
 MailBox::~MailBox()
 { 
     delete messages; 
+    delete arrived;
 }
 
 //----------------------------------------------------------------------
@@ -87,7 +91,11 @@ PrintHeader(PacketHeader pktHdr, MailHeader mailHdr)
 //	arrival, wake them up!
 //
 //	We need to reconstruct the Mail message (by concatenating the headers
-//	to the data), to simplify queueing the message on the SynchList.
+//	to the data), to simplify queueing the message on the list.
+//
+//	The post office delivers mail from a kernel task, which must not
+//	wait, so the list is protected by disabling interrupts rather
+//	than by a Lock.
 //
 //	"pktHdr" -- source, destination machine ID's
 //	"mailHdr" -- source, destination mailbox ID's
@@ -98,10 +106,13 @@ void
 MailBox::Put(PacketHeader pktHdr, MailHeader mailHdr, char *data)
 { 
     Mail *mail = new Mail(pktHdr, mailHdr, data); 
+    IntStatus oldLevel = kernel->interrupt->SetLevel(IntOff);
 
     messages->Append(mail);		// put on the end of the list of 
 					// arrived messages, and wake up 
 					// any waiters
+    arrived->V();
+    (void) kernel->interrupt->SetLevel(oldLevel);
 }
 
 //----------------------------------------------------------------------
@@ -120,8 +131,13 @@ void
 MailBox::Get(PacketHeader *pktHdr, MailHeader *mailHdr, char *data) 
 { 
     DEBUG(dbgNet, "Waiting for mail in mailbox");
-    Mail *mail = messages->RemoveFront();	// remove message from list;
-						// will wait if list is empty
+    Mail *mail;
+    IntStatus oldLevel;
+
+    arrived->P();			// wait if list is empty
+    oldLevel = kernel->interrupt->SetLevel(IntOff);
+    mail = messages->RemoveFront();	// remove message from list
+    (void) kernel->interrupt->SetLevel(oldLevel);
 
     *pktHdr = mail->pktHdr;
     *mailHdr = mail->mailHdr;
@@ -142,91 +158,85 @@ MailBox::Get(PacketHeader *pktHdr, MailHeader *mailHdr, char *data)
 //	Also initialize the network device, to allow post offices
 //	on different machines to deliver messages to one another.
 //
-//      We use a separate thread "the postal worker" to wait for messages 
-//	to arrive, and deliver them to the correct mailbox.  Note that
-//	delivering messages to the mailboxes can't be done directly
-//	by the interrupt handlers, because it requires a Lock.
+//      We use a kernel task, "the postal worker", to deliver messages
+//	to the correct mailbox as they arrive.  It needs no stack or
+//	thread of its own: the interrupt handler posts it, and the
+//	scheduler runs it as soon as the handler returns.
 //
 //	"nBoxes" is the number of mail boxes in this Post Office
 //----------------------------------------------------------------------
 
 PostOfficeInput::PostOfficeInput(int nBoxes)
 {
-    messageAvailable = new Semaphore("message available", 0);
+    delivery = new KernelTask("postal worker", 
+			&PostOfficeInput::PostalDelivery_st, this);
+    buffer = new char[MaxPacketSize];
 
     numBoxes = nBoxes;
     boxes = new MailBox[nBoxes];
 
     network = new NetworkInput(this);
-
-    Thread *t = new Thread("postal worker");
-
-    t->Fork((VoidFunctionPtr) &PostOfficeInput::PostalDelivery_st, this);
 }
 
 //----------------------------------------------------------------------
 // PostOfficeInput::~PostOfficeInput
 // 	De-allocate the post office data structures.
-//	
-//	Since the postal helper is waiting on the "messageAvail" semaphore,
-//	we don't deallocate it!  This leaves garbage lying about,
-//	but the alternative is worse!
 //----------------------------------------------------------------------
 
 PostOfficeInput::~PostOfficeInput()
 {
     delete network;
+    delete delivery;
+    delete [] buffer;
     delete [] boxes;
 }
 
 //----------------------------------------------------------------------
 // PostOffice::PostalDelivery_st
-//      static member function of PostOffice::PostalDelivery
-//
-//      Incoming messages have had the PacketHeader stripped off,
-//      but the MailHeader is still tacked on the front of the data.
+//      static member function of PostOffice::PostalDelivery, for the
+//	postal worker task
 //----------------------------------------------------------------------
 
-void
-PostOfficeInput::PostalDelivery_st( PostOfficeInput * input )
+bool
+PostOfficeInput::PostalDelivery_st(void *input)
 {
-    input->PostalDelivery();
+    return ((PostOfficeInput *) input)->PostalDelivery();
 }
 
 
 //----------------------------------------------------------------------
 // PostOffice::PostalDelivery
-// 	Wait for incoming messages, and put them in the right mailbox.
+// 	Put the message that has arrived in the right mailbox.  Run by
+//	the postal worker task; the network holds only one incoming
+//	packet at a time, and posts the task again for the next one.
 //
 //      Incoming messages have had the PacketHeader stripped off,
 //	but the MailHeader is still tacked on the front of the data.
 //----------------------------------------------------------------------
 
-void
+bool
 PostOfficeInput::PostalDelivery()
 {
     PacketHeader pktHdr;
     MailHeader mailHdr;
-    char *buffer = new char[MaxPacketSize];
 
-    for (;;) {
-        // first, wait for a message
-        messageAvailable->P();	
-        pktHdr = network->Receive(buffer);
+    pktHdr = network->Receive(buffer);
+    if (pktHdr.length == 0)		// nothing there after all
+	return FALSE;
 
-        mailHdr = *(MailHeader *)buffer;
-        if (debug->IsEnabled('n')) {
-	    cout << "Putting mail into mailbox: ";
-	    PrintHeader(pktHdr, mailHdr);
-        }
+    mailHdr = *(MailHeader *)buffer;
+    if (debug->IsEnabled('n')) {
+	cout << "Putting mail into mailbox: ";
+	PrintHeader(pktHdr, mailHdr);
+    }
 
-	// check that arriving message is legal!
-	ASSERT(0 <= mailHdr.to && mailHdr.to < numBoxes);
-	ASSERT(mailHdr.length <= MaxMailSize);
+    // check that arriving message is legal!
+    ASSERT(0 <= mailHdr.to && mailHdr.to < numBoxes);
+    ASSERT(mailHdr.length <= MaxMailSize);
 
-	// put into mailbox
-        boxes[mailHdr.to].Put(pktHdr, mailHdr, buffer + sizeof(MailHeader));
-    }
+    // put into mailbox
+    boxes[mailHdr.to].Put(pktHdr, mailHdr, buffer + sizeof(MailHeader));
+    return FALSE;
 }
 
 //----------------------------------------------------------------------
@@ -258,13 +268,13 @@ PostOfficeInput::Receive(int box, PacketHeader *pktHdr,
 // PostOffice::CallBack
 // 	Interrupt handler, called when a packet arrives from the network.
 //
-//	Signal the PostalDelivery routine that it is time to get to work!
+//	Post the postal worker task, so PostalDelivery gets to work!
 //----------------------------------------------------------------------
 
 void
 PostOfficeInput::CallBack()
 { 
-    messageAvailable->V(); 
+    delivery->Post(); 
 }
 
 //----------------------------------------------------------------------
@@ -30,8 +30,9 @@
 #include "utility.h"
 #include "callback.h"
 #include "network.h"
-#include "synchlist.h"
+#include "list.h"
 #include "synch.h"
+#include "kerneltask.h"
 
 // Mailbox address -- uniquely identifies a mailbox on a given machine.
 // A mailbox is just a place for temporary storage for messages.
@@ -84,12 +85,14 @@ class MailBox {
 
     void Put(PacketHeader pktHdr, MailHeader mailHdr, char *data);
    				// Atomically put a message into the mailbox
+				// (never waits, so tasks may call it)
     void Get(PacketHeader *pktHdr, MailHeader *mailHdr, char *data); 
    				// Atomically get a message out of the 
 				// mailbox (and wait if there is no message 
 				// to get!)
   private:
-    SynchList<Mail *> *messages; // A mailbox is just a list of arrived messages
+    List<Mail *> *messages;	// A mailbox is just a list of arrived messages
+    Semaphore *arrived;		// one V for each message in "messages"
 };
 
 // The following two classes defines a "Post Office", or a collection of 
@@ -110,19 +113,21 @@ class PostOfficeInput : public CallBackObj {
 		MailHeader *mailHdr, char *data);
     				// Retrieve a message from "box".  Wait if
 				// there is no message in the box.
-    static void PostalDelivery_st( PostOfficeInput *);
-    void PostalDelivery();	// Wait for incoming messages, 
-				// and then put them in the correct mailbox
+    static bool PostalDelivery_st(void *input);
+    bool PostalDelivery();	// Put an incoming message in the
+				// correct mailbox
 
     void CallBack();		// Called when incoming packet has arrived 
 				// and can be pulled off of network 
-				// (i.e., time to call PostalDelivery)
+				// (i.e., time to run PostalDelivery)
 
   private:
     NetworkInput *network;	// Physical network connection
     MailBox *boxes;		// Table of mail boxes to hold incoming mail
     int numBoxes;		// Number of mail boxes
-    Semaphore *messageAvailable;// V'ed when message has arrived from network
+    KernelTask *delivery;	// posted when message has arrived from
+				// network; runs PostalDelivery
+    char *buffer;		// where PostalDelivery receives it
 };
 
 class PostOfficeOutput : public CallBackObj {
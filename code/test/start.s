@@ -138,6 +138,14 @@ PrintInt:
 	j       $31
 	.end    PrintInt
 
+	.globl  SetTickets
+	.ent    SetTickets
+SetTickets:
+	addiu   $2,$0,SC_SetTickets
+	syscall
+	j       $31
+	.end    SetTickets
+
 /* dummy function to keep gcc happy */
         .globl  __main
         .ent    __main
@@ -52,16 +52,21 @@ Alarm::CallBack()
     Interrupt *interrupt = kernel->interrupt;
     MachineStatus status = interrupt->getStatus();
     
-    kernel->currentThread->setPriority(kernel->currentThread->getPriority() - 1);
     if (status == IdleMode) {	// is it time to quit?
         if (!interrupt->AnyFutureInterrupts()) {
 	    timer->Disable();	// turn off the timer
 	}
     } else {			// there's someone to preempt
-	if(kernel->scheduler->getSchedulerType() == RR ||
-            kernel->scheduler->getSchedulerType() == Priority ) {
+	if (kernel->scheduler->TimerTick()) {
 		interrupt->YieldOnReturn();
 	}
+	// there is one timer; the other processors hear from it by IPI
+	for (int cpu = 0; cpu < kernel->scheduler->NumCpus(); cpu++) {
+		if (cpu != kernel->scheduler->CurrentCpu() &&
+				!kernel->scheduler->IsCpuIdle(cpu) &&
+				kernel->scheduler->getSchedulerType() == RR)
+			interrupt->SendIPI(cpu);
+	}
     }
 }
 
@@ -31,6 +31,11 @@ class Alarm : public CallBackObj {
     
     void WaitUntil(int x);	// suspend execution until time > now + x
 
+    void Resume() { timer->Enable(); }
+				// Restart time slicing, after the timer
+				// turned itself off because the machine
+				// was idle
+
   private:
     Timer *timer;		// the hardware timer device
 
@@ -26,6 +26,8 @@ ThreadedKernel::ThreadedKernel(int argc, char **argv)
 {
     randomSlice = FALSE; 
     type = RR;
+    numCpus = 1;
+    maxFreeStacks = DefaultMaxFreeStacks;
 
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "-rs") == 0) {
@@ -34,8 +36,20 @@ ThreadedKernel::ThreadedKernel(int argc, char **argv)
 					// number generator
 	    randomSlice = TRUE;
 	    i++;
+        } else if (strcmp(argv[i], "-cpus") == 0) {
+	    ASSERT(i + 1 < argc);
+	    numCpus = atoi(argv[i + 1]);
+	    ASSERT(1 <= numCpus && numCpus <= MaxCpus);
+	    i++;
+        } else if (strcmp(argv[i], "-stackpool") == 0) {
+	    ASSERT(i + 1 < argc);
+	    maxFreeStacks = atoi(argv[i + 1]);
+	    ASSERT(maxFreeStacks >= 0);
+	    i++;
         } else if (strcmp(argv[i], "-u") == 0) {
             cout << "Partial usage: nachos [-rs randomSeed]\n";
+            cout << "Partial usage: nachos [-cpus count]\n";
+            cout << "Partial usage: nachos [-stackpool count]\n";
 	    } else if(strcmp(argv[i], "-sche") == 0) {
             if (!(i + 1 < argc)){
                 cout << "Partial usage: nachos [-sche Schedluer Type]\n";
@@ -47,9 +61,21 @@ ThreadedKernel::ThreadedKernel(int argc, char **argv)
                 type = Priority;
             } else if (strcmp(argv[i + 1], "SJF") == 0) {
                 type = SJF;
+            } else if (strcmp(argv[i + 1], "MLFQ") == 0) {
+                type = MLFQ;
+            } else if (strcmp(argv[i + 1], "SRTF") == 0) {
+                type = SRTF;
+            } else if (strcmp(argv[i + 1], "STRIDE") == 0) {
+                type = Stride;
+            } else if (strcmp(argv[i + 1], "LOTTERY") == 0) {
+                type = Lottery;
             }
         }
     }
+    if (numCpus > 1 && type != RR && type != FIFO) {
+	cout << "-cpus only works with -sche RR or FCFS\n";
+	Exit(1);
+    }
 }
 
 //----------------------------------------------------------------------
@@ -66,12 +92,15 @@ ThreadedKernel::Initialize()
     interrupt = new Interrupt;		// start up interrupt handling
     scheduler = new Scheduler(type);	// initialize the ready queue
     alarm = new Alarm(randomSlice);	// start up time slicing
+    stackPool = new StackPool(StackSize, maxFreeStacks);
 
     // We didn't explicitly allocate the current thread we are running in.
     // But if it ever tries to give up the CPU, we better have a Thread
     // object to save its state. 
     currentThread = new Thread("main");		
     currentThread->setStatus(RUNNING);
+    if (numCpus > 1)
+	scheduler->StartCpus(numCpus);
 
     interrupt->Enable();
 }
@@ -85,6 +114,7 @@ ThreadedKernel::~ThreadedKernel()
 {
     delete alarm;
     delete scheduler;
+    delete stackPool;
     delete interrupt;
     delete stats;
     
@@ -122,7 +152,9 @@ ThreadedKernel::SelfTest() {
    
    LibSelfTest();		// test library routines
    
+   stackPool->SelfTest();	// test stack recycling
    currentThread->SelfTest();	// test thread switching
+   KernelTask::SelfTest();	// test kernel tasks
    
    				// test semaphore operation
    semaphore = new Semaphore("test", 0);
@@ -134,6 +166,8 @@ ThreadedKernel::SelfTest() {
    synchList = new SynchList<int>;
    synchList->SelfTest(9);
    delete synchList;
+   Lock::SelfTest();		// test priority inheritance
+   scheduler->SelfTest();	// test priority preemption
 
    ElevatorSelfTest();
 }
@@ -16,6 +16,7 @@
 #include "interrupt.h"
 #include "stats.h"
 #include "alarm.h"
+#include "stackpool.h"
 
 class ThreadedKernel {
   public:
@@ -41,10 +42,13 @@ class ThreadedKernel {
     Interrupt *interrupt;	// interrupt status
     Statistics *stats;		// performance metrics
     Alarm *alarm;		// the software alarm clock    
+    StackPool *stackPool;	// stacks of threads that have finished
 
   private:
     bool randomSlice;		// enable pseudo-random time slicing
     SchedulerType type;
+    int numCpus;		// simulated processors
+    int maxFreeStacks;		// stacks of each size to keep for reuse
 };
 
 
@@ -0,0 +1,127 @@
+// kerneltask.cc
+//	Routines to manage kernel tasks.  See kerneltask.h.
+//
+//	The scheduler keeps the tasks that have been posted, and runs them
+//	whenever it checks for interrupts (see Scheduler::RunTasks).
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "kerneltask.h"
+#include "main.h"
+
+//----------------------------------------------------------------------
+// KernelTask::KernelTask
+// 	Initialize a task.  It does nothing until it is posted.
+//
+//	"debugName" is an arbitrary string, useful for debugging.
+//	"step" is the procedure to call each time the task is run.
+//	"arg" is passed to "step"; it holds whatever the task needs to
+//		remember between steps.
+//----------------------------------------------------------------------
+
+KernelTask::KernelTask(char *debugName, TaskStepPtr step, void *arg)
+{
+    name = debugName;
+    this->step = step;
+    this->arg = arg;
+    posted = FALSE;
+}
+
+//----------------------------------------------------------------------
+// KernelTask::~KernelTask
+// 	De-allocate a task.  If it has been posted but has not run yet,
+//	take it off the scheduler's list, so it never will.
+//----------------------------------------------------------------------
+
+KernelTask::~KernelTask()
+{
+    IntStatus oldLevel = kernel->interrupt->SetLevel(IntOff);
+
+    if (posted)
+	kernel->scheduler->CancelTask(this);
+    (void) kernel->interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// KernelTask::Post
+// 	There is work for the task to do; have the scheduler run it.
+//	May be called by interrupt handlers, and by tasks.
+//----------------------------------------------------------------------
+
+void
+KernelTask::Post()
+{
+    IntStatus oldLevel = kernel->interrupt->SetLevel(IntOff);
+
+    if (!posted) {
+	DEBUG(dbgThread, "Posting task: " << name);
+	posted = TRUE;
+	kernel->scheduler->ReadyTask(this);
+    }
+    (void) kernel->interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// KernelTask::Run
+// 	Take one step of the task, and post it again if the step says it
+//	has more to do.  Called by the scheduler, with interrupts
+//	disabled, after taking the task off its list.
+//----------------------------------------------------------------------
+
+void
+KernelTask::Run()
+{
+    ASSERT(kernel->interrupt->getLevel() == IntOff);
+    ASSERT(posted);
+
+    DEBUG(dbgThread, "Running task: " << name);
+    posted = FALSE;
+    if ((*step)(arg))
+	Post();
+}
+
+//----------------------------------------------------------------------
+// CountStep
+// 	Step function for KernelTask::SelfTest: count how many times we
+//	have run, and ask to run again until we have run three times.
+//----------------------------------------------------------------------
+
+static bool
+CountStep(void *arg)
+{
+    int *count = (int *) arg;
+
+    (*count)++;
+    return *count < 3;
+}
+
+//----------------------------------------------------------------------
+// KernelTask::SelfTest
+// 	Test whether tasks work: posting a task twice runs it once, a
+//	task that asks to run again gets one step each time the scheduler
+//	runs tasks, and deleting a posted task keeps it from running.
+//----------------------------------------------------------------------
+
+void
+KernelTask::SelfTest()
+{
+    Scheduler *scheduler = kernel->scheduler;
+    int count = 0;
+    KernelTask *task = new KernelTask("count", CountStep, &count);
+    IntStatus oldLevel = kernel->interrupt->SetLevel(IntOff);
+
+    task->Post();
+    task->Post();
+    ASSERT(scheduler->RunTasks() && count == 1);
+    ASSERT(scheduler->RunTasks() && count == 2);
+    ASSERT(scheduler->RunTasks() && count == 3);
+    ASSERT(!scheduler->RunTasks());
+
+    task->Post();
+    delete task;
+    ASSERT(!scheduler->RunTasks() && count == 3);
+    (void) kernel->interrupt->SetLevel(oldLevel);
+}
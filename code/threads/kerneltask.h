@@ -0,0 +1,61 @@
+// kerneltask.h
+//	Data structures for kernel tasks: small pieces of kernel work that
+//	run without a stack of their own.
+//
+//	A service thread that spends its life waiting for an event and
+//	then doing a little work (delivering a packet, say) costs a whole
+//	stack, and a full context switch every time it is woken up.  A
+//	task is the same loop turned inside out: instead of waiting, it
+//	is "posted" when there is work for it, and the scheduler then
+//	calls its step function on whatever stack is running.  Whatever
+//	the task must remember from one step to the next (its
+//	continuation) is kept in the object passed to the step function.
+//
+//	Steps run with interrupts disabled, like interrupt handlers, but
+//	they may be posted by anyone -- interrupt handlers included.  So
+//	like an interrupt handler, a step must never wait: no Semaphore
+//	P, no Lock Acquire, no Thread Sleep or Yield.  A task that needs
+//	to wait for something should return, and have whatever it is
+//	waiting for post it again.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef KERNELTASK_H
+#define KERNELTASK_H
+
+#include "copyright.h"
+
+// A task's step function.  It returns TRUE if it has more work to do
+// right away, and so should be run again (after anything else that is
+// waiting to run), and FALSE if it has nothing to do until it is next
+// posted.
+
+typedef bool (*TaskStepPtr)(void *arg);
+
+class KernelTask {
+  public:
+    KernelTask(char *debugName, TaskStepPtr step, void *arg);
+				// initialize a task, which will call
+				// "step(arg)" each time it is run
+    ~KernelTask();		// de-allocate the task, and forget it
+				// if it has been posted
+
+    void Post();		// there is work for the task: run it
+				// soon.  Posting it again before it has
+				// run has no further effect.
+    void Run();			// called by the scheduler: take one step
+
+    char *getName() { return name; }
+
+    static void SelfTest();	// test whether tasks work
+
+  private:
+    char *name;
+    TaskStepPtr step;		// what to call to run the task
+    void *arg;			// and what to pass it
+    bool posted;		// waiting for the scheduler to run it?
+};
+
+#endif // KERNELTASK_H
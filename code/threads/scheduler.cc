@@ -24,12 +24,27 @@
 #include "main.h"
 
 //----------------------------------------------------------------------
-// Compare function
+// RemainingBurst, BurstCompare
+// 	How much of its predicted burst a ready thread has left, and
+//	the order SJF and SRTF run threads in: least left first.
 //----------------------------------------------------------------------
-int PriorityCompare(Thread *a, Thread *b) {
-    if(a->getPriority() == b->getPriority())
+
+static int
+RemainingBurst(Thread *t)
+{
+    int left = t->cpu.predictedBurst - t->cpu.burstUsed;
+
+    return left > 0 ? left : 0;
+}
+
+int BurstCompare(Thread *a, Thread *b) {
+    return RemainingBurst(a) - RemainingBurst(b);
+}
+
+int PassCompare(Thread *a, Thread *b) {
+    if (a->cpu.pass == b->cpu.pass)
         return 0;
-    return a->getPriority() > b->getPriority() ? 1 : -1;
+    return a->cpu.pass > b->cpu.pass ? 1 : -1;
 }
 
 //----------------------------------------------------------------------
@@ -46,21 +61,49 @@ Scheduler::Scheduler()
 Scheduler::Scheduler(SchedulerType type)
 {
 	schedulerType = type;
+	readyList = NULL;
+	readyHeap = NULL;
+	readyTickets = 0;
+	globalPass = 0;
+	numShares = 0;
+	numCpus = 1;
+	currentCpu = 0;
+	for (int i = 0; i < MaxCpus; i++)
+	    cpus[i].readyQueue = NULL;
+	for (int i = 0; i < NumPriorities; i++)
+	    levels[i] = NULL;
+	levelMask = 0;
+	nextBoost = MLFQBoostPeriod;
+	nextAging = AgingPeriod;
 	switch(schedulerType) {
     	case RR:
         	readyList = new List<Thread *>;
         	break;
     	case SJF:
-		    /* todo */
+    	case SRTF:
+		    readyHeap = new Heap<Thread *>(BurstCompare);
+        	break;
+    	case Stride:
+		    readyHeap = new Heap<Thread *>(PassCompare);
+        	break;
+    	case Lottery:
+		    readyList = new List<Thread *>;
         	break;
     	case Priority:
-		    readyList = new SortedList<Thread *>(PriorityCompare);
+		    for (int i = 0; i < NumPriorities; i++)
+			levels[i] = new List<Thread *>;
         	break;
     	case FIFO:
-            /* todo */
+            readyList = new List<Thread *>;
+            break;
+    	case MLFQ:
+            for (int i = 0; i < NumPriorities; i++)
+                levels[i] = new List<Thread *>;	// only MLFQLevels used
             break;
    	}
 	toBeDestroyed = NULL;
+	readyTasks = new List<KernelTask *>;
+	runningTask = NULL;
 } 
 
 //----------------------------------------------------------------------
@@ -71,6 +114,12 @@ Scheduler::Scheduler(SchedulerType type)
 Scheduler::~Scheduler()
 { 
     delete readyList; 
+    delete readyHeap;
+    for (int i = 0; i < MaxCpus; i++)
+	delete cpus[i].readyQueue;
+    for (int i = 0; i < NumPriorities; i++)
+	delete levels[i];
+    delete readyTasks;
 } 
 
 //----------------------------------------------------------------------
@@ -87,8 +136,45 @@ Scheduler::ReadyToRun (Thread *thread)
     ASSERT(kernel->interrupt->getLevel() == IntOff);
     DEBUG(dbgThread, "Putting thread on ready list: " << thread->getName());
     
+    if (thread->getStatus() == JUST_CREATED) {
+	thread->cpu.createdAt = kernel->stats->totalTicks;
+	thread->cpu.predictedBurst = thread->getBurstTime() > 0 ?
+				thread->getBurstTime() : DefaultBurst;
+	thread->cpu.pass = globalPass;	// start even with everyone else
+	if (numShares < MaxShareRecords) {
+	    thread->cpu.shareSlot = numShares++;
+	    shares[thread->cpu.shareSlot].name = thread->getName();
+	    shares[thread->cpu.shareSlot].tickets = thread->cpu.tickets;
+	    shares[thread->cpu.shareSlot].ticksRun = 0;
+	}
+    } else if (thread == kernel->currentThread) {
+	EndBurst(thread, FALSE);	// preempted, or yielding
+    } else if (thread->cpu.pass < globalPass) {
+	thread->cpu.pass = globalPass;	// don't let a thread that was
+					// blocked catch up all at once
+    }
+    thread->cpu.readySince = kernel->stats->totalTicks;
+
     thread->setStatus(READY);
-    readyList->Append(thread);
+    if (numCpus > 1) {
+	int cpu = PickCpu(thread);
+
+	cpus[cpu].readyQueue->Append(thread);
+	if (cpus[cpu].idle)
+	    kernel->interrupt->SendIPI(cpu);
+	else
+	    WakeThief();
+    } else if (readyHeap != NULL) {
+	readyHeap->Insert(thread);
+    } else if (schedulerType == MLFQ || schedulerType == Priority) {
+	int level = LevelOf(thread);
+
+	levels[level]->Append(thread);
+	levelMask |= 1 << level;
+    } else {
+	readyList->Append(thread);
+	readyTickets += thread->cpu.tickets;
+    }
 }
 
 //----------------------------------------------------------------------
@@ -104,6 +190,37 @@ Scheduler::FindNextToRun ()
 {
     ASSERT(kernel->interrupt->getLevel() == IntOff);
 
+    if (numCpus > 1) {
+	Deque<Thread *> *queue = cpus[currentCpu].readyQueue;
+
+	return queue->IsEmpty() ? Steal() : queue->RemoveFront();
+    }
+    if (readyHeap != NULL) {
+	return readyHeap->IsEmpty() ? NULL : readyHeap->RemoveFront();
+    }
+    if (schedulerType == Lottery && !readyList->IsEmpty()) {
+	int winner = RandomNumber() % readyTickets;
+	Thread *thread = NULL;
+
+	for (ListIterator<Thread *> it(readyList); winner >= 0; it.Next()) {
+	    thread = it.Item();
+	    winner -= thread->cpu.tickets;
+	}
+	readyList->Remove(thread);
+	readyTickets -= thread->cpu.tickets;
+	return thread;
+    }
+    if (schedulerType == MLFQ || schedulerType == Priority) {
+	int level = HighestLevel();
+	Thread *thread;
+
+	if (level == NumPriorities)
+	    return NULL;
+	thread = levels[level]->RemoveFront();
+	if (levels[level]->IsEmpty())
+	    levelMask &= ~(1 << level);
+	return thread;
+    }
     if (readyList->IsEmpty()) {
 	return NULL;
     } else {
@@ -111,6 +228,381 @@ Scheduler::FindNextToRun ()
     }
 }
 
+//----------------------------------------------------------------------
+// Scheduler::LevelOf
+// 	Return which of the ready queues in "levels" "thread" belongs
+//	on: its MLFQ level, or its priority, counting any it has
+//	inherited (kept in range).
+//----------------------------------------------------------------------
+
+int
+Scheduler::LevelOf(Thread *thread)
+{
+    int level;
+
+    if (schedulerType == MLFQ)
+	return thread->getLevel();
+    level = thread->getEffectivePriority();
+    if (level < 0)
+	return 0;
+    if (level >= NumPriorities)
+	return NumPriorities - 1;
+    return level;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::HighestLevel
+// 	Return the highest priority (lowest numbered) level that has a
+//	thread ready to run, or NumPriorities if there is none.  Takes
+//	constant time, however many levels there are.
+//----------------------------------------------------------------------
+
+int
+Scheduler::HighestLevel()
+{
+    if (levelMask == 0)
+	return NumPriorities;
+    return __builtin_ctz(levelMask);	// index of the lowest set bit
+}
+
+//----------------------------------------------------------------------
+// Scheduler::TimerTick
+// 	Called by the alarm on every timer interrupt while a thread is
+//	running.  Decide whether the time slice is over.
+//
+//	Under MLFQ, the thread at level i may run for 2^i timer
+//	interrupts before it is moved down a level; after that, or any
+//	time a thread is ready at a higher level, it is preempted -- but
+//	only in favor of a thread at its own level or above.  Every
+//	MLFQBoostPeriod ticks all the threads are boosted back to level 0.
+//
+//	Under Priority, the running thread drops a step, and every
+//	AgingPeriod ticks the waiting threads rise a step.  Then, as
+//	under MLFQ, it is preempted only in favor of a thread at its own
+//	(effective) priority or above.
+//
+//	Under SRTF, the thread is preempted if a ready thread is predicted
+//	to finish its burst sooner than the running thread will.  (We
+//	only check on timer interrupts, so a thread that wakes up with a
+//	shorter burst may wait up to TimerTicks for the CPU.)
+//
+//	The other schedulers just slice (RR, Stride and Lottery) or
+//	don't (FIFO and SJF).
+//----------------------------------------------------------------------
+
+bool
+Scheduler::TimerTick()
+{
+    Thread *thread = kernel->currentThread;
+    int level;
+
+    switch (schedulerType) {
+      case Priority:
+	if (kernel->stats->totalTicks >= nextAging) {
+	    Age();
+	    nextAging = kernel->stats->totalTicks + AgingPeriod;
+	}
+	SetPriority(thread, thread->getPriority() + 1);
+	return HighestLevel() <= LevelOf(thread);
+      case RR:
+      case Stride:
+      case Lottery:
+	return TRUE;
+      case MLFQ:
+	break;
+      case SRTF:
+	if (readyHeap->IsEmpty())
+	    return FALSE;
+	return RemainingBurst(readyHeap->Front()) < 
+		thread->cpu.predictedBurst - thread->cpu.burstUsed
+			- (kernel->stats->totalTicks - thread->cpu.dispatchedAt);
+      default:
+	return FALSE;
+    }
+
+    if (kernel->stats->totalTicks >= nextBoost) {
+	Boost();
+	nextBoost = kernel->stats->totalTicks + MLFQBoostPeriod;
+    }
+
+    level = thread->getLevel();
+    thread->setQuantumUsed(thread->getQuantumUsed() + 1);
+    if (thread->getQuantumUsed() >= (1 << level)) {
+	if (level + 1 < MLFQLevels) {
+	    level++;
+	    DEBUG(dbgThread, "Moving thread " << thread->getName() 
+					<< " down to level " << level);
+	}
+	thread->setLevel(level);
+	thread->setQuantumUsed(0);
+	return HighestLevel() <= level;
+    }
+    return HighestLevel() < level;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::EndBurst
+// 	"thread" is giving up the CPU: add the time it has run since it
+//	was dispatched to its current burst.  If the burst is over
+//	("done" -- it is blocking or finishing), fold its length into the
+//	prediction for the next one:
+//
+//	    predicted = w * actual + (1 - w) * predicted
+//----------------------------------------------------------------------
+
+void
+Scheduler::EndBurst(Thread *thread, bool done)
+{
+    CpuAccount *cpu = &thread->cpu;
+    int ran = kernel->stats->totalTicks - cpu->dispatchedAt;
+
+    cpu->burstUsed += ran;
+    cpu->dispatchedAt = kernel->stats->totalTicks;
+    cpu->pass += ran * (StrideOne / cpu->tickets);
+    if (cpu->shareSlot >= 0)
+	shares[cpu->shareSlot].ticksRun += ran;
+    if (done) {
+	cpu->predictedBurst = (BurstWeight * cpu->burstUsed
+			+ (4 - BurstWeight) * cpu->predictedBurst) / 4;
+	DEBUG(dbgThread, "Thread " << thread->getName() << " ran for " 
+		<< cpu->burstUsed << " ticks, next burst predicted " 
+		<< cpu->predictedBurst);
+	cpu->burstUsed = 0;
+    }
+}
+
+//----------------------------------------------------------------------
+// Scheduler::SetPriority
+// 	Give "thread" a new priority, kept within 0..NumPriorities-1.
+//	If it is waiting on the ready list, move it to its new queue,
+//	behind the threads already there.
+//----------------------------------------------------------------------
+
+void
+Scheduler::SetPriority(Thread *thread, int priority)
+{
+    int oldLevel;
+
+    if (priority < 0)
+	priority = 0;
+    else if (priority >= NumPriorities)
+	priority = NumPriorities - 1;
+    if (schedulerType != Priority || thread->getStatus() != READY) {
+	thread->setPriority(priority);
+	return;
+    }
+
+    oldLevel = LevelOf(thread);
+    thread->setPriority(priority);
+    Requeue(thread, oldLevel);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::SetInheritedPriority
+// 	Record that "thread" has inherited "priority" (or NotInherited,
+//	if it no longer has any) from threads waiting for its locks.
+//	Until that changes, it runs at this priority, if that is higher
+//	than its own.  If it is waiting on the ready list, move it to
+//	its new queue, as for SetPriority.
+//----------------------------------------------------------------------
+
+void
+Scheduler::SetInheritedPriority(Thread *thread, int priority)
+{
+    int oldLevel;
+
+    if (schedulerType != Priority || thread->getStatus() != READY) {
+	thread->cpu.inherited = priority;
+	return;
+    }
+
+    oldLevel = LevelOf(thread);
+    thread->cpu.inherited = priority;
+    Requeue(thread, oldLevel);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Requeue
+// 	The priority of "thread", which is on the ready list at level
+//	"oldLevel", has changed: move it to the back of its new level.
+//----------------------------------------------------------------------
+
+void
+Scheduler::Requeue(Thread *thread, int oldLevel)
+{
+    int newLevel = LevelOf(thread);
+
+    if (newLevel == oldLevel)
+	return;
+    levels[oldLevel]->Remove(thread);
+    if (levels[oldLevel]->IsEmpty())
+	levelMask &= ~(1 << oldLevel);
+    levels[newLevel]->Append(thread);
+    levelMask |= 1 << newLevel;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Age
+// 	Raise every waiting thread's own priority one step, keeping the
+//	order within each queue: each thread is moved onto the end of the
+//	queue for its new priority.  A thread that is there because of a
+//	priority it inherited through a lock may stay where it is; it
+//	still gains a step of its own, for when the lock is released.
+//	Going from the top down, and only taking the threads that were
+//	on each queue to start with, no thread moves twice.
+//----------------------------------------------------------------------
+
+void
+Scheduler::Age()
+{
+    Thread *thread;
+    int n;
+
+    DEBUG(dbgThread, "Aging the waiting threads");
+    for (int i = 0; i < NumPriorities; i++) {
+	for (n = levels[i]->NumInList(); n > 0; n--) {
+	    thread = levels[i]->RemoveFront();
+	    if (thread->getPriority() > 0)
+		thread->setPriority(thread->getPriority() - 1);
+	    levels[LevelOf(thread)]->Append(thread);
+	}
+    }
+    levelMask = 0;
+    for (int i = 0; i < NumPriorities; i++) {
+	if (!levels[i]->IsEmpty())
+	    levelMask |= 1 << i;
+    }
+}
+
+//----------------------------------------------------------------------
+// Scheduler::SetTickets
+// 	Give "thread" a new number of tickets.  It must not be on the
+//	ready list.
+//----------------------------------------------------------------------
+
+void
+Scheduler::SetTickets(Thread *thread, int tickets)
+{
+    ASSERT(tickets > 0 && thread->getStatus() != READY);
+
+    DEBUG(dbgThread, "Thread " << thread->getName() << " has " << tickets 
+		<< " tickets");
+    thread->cpu.tickets = tickets;
+    if (thread->cpu.shareSlot >= 0)
+	shares[thread->cpu.shareSlot].tickets = tickets;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::PrintShares
+// 	Under Stride or Lottery, print the share of the CPU each thread
+//	was meant to get (its tickets over everyone's tickets) and the
+//	share it got (the CPU time it used over everyone's).  Tickets
+//	changed along the way are counted at their final value.
+//----------------------------------------------------------------------
+
+void
+Scheduler::PrintShares()
+{
+    int totalTickets = 0, totalRun = 0;
+
+    if (schedulerType != Stride && schedulerType != Lottery)
+	return;
+    EndBurst(kernel->currentThread, FALSE);	// charge it up to now
+    for (int i = 0; i < numShares; i++) {
+	totalTickets += shares[i].tickets;
+	totalRun += shares[i].ticksRun;
+    }
+    if (totalRun == 0)
+	return;
+    for (int i = 0; i < numShares; i++) {
+	cout << "Share of " << shares[i].name << ": tickets " 
+	     << shares[i].tickets << ", requested "
+	     << 100 * shares[i].tickets / totalTickets << "%, achieved "
+	     << (int) (100LL * shares[i].ticksRun / totalRun) << "%\n";
+    }
+}
+
+//----------------------------------------------------------------------
+// Scheduler::ReadyTask
+// 	A task has been posted; remember to run it.  Tasks run in the
+//	order they were posted.
+//----------------------------------------------------------------------
+
+void
+Scheduler::ReadyTask(KernelTask *task)
+{
+    ASSERT(kernel->interrupt->getLevel() == IntOff);
+    readyTasks->Append(task);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::CancelTask
+// 	A posted task is being deleted before it could run.
+//----------------------------------------------------------------------
+
+void
+Scheduler::CancelTask(KernelTask *task)
+{
+    ASSERT(kernel->interrupt->getLevel() == IntOff);
+    readyTasks->Remove(task);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::RunTasks
+// 	Run one step of each task that has been posted.  Called with
+//	interrupts disabled, after any interrupt handlers that are due
+//	have run, on the stack of whatever thread is running.  Tasks
+//	posted meanwhile (including ones that ask to run again) wait
+//	for the next call, so that a busy task can't keep the threads
+//	from running.
+//
+//	Returns TRUE if any task was run.
+//----------------------------------------------------------------------
+
+bool
+Scheduler::RunTasks()
+{
+    int n = readyTasks->NumInList();
+
+    ASSERT(kernel->interrupt->getLevel() == IntOff);
+    ASSERT(runningTask == NULL);
+    for (int i = 0; i < n; i++) {
+	runningTask = readyTasks->RemoveFront();
+	runningTask->Run();
+	kernel->stats->numTaskSteps++;
+    }
+    runningTask = NULL;
+    return n > 0;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Boost
+// 	Move every thread, ready or running, back to MLFQ level 0, with
+//	a fresh quantum.  Threads keep their order within each level,
+//	and higher levels go first.
+//----------------------------------------------------------------------
+
+void
+Scheduler::Boost()
+{
+    Thread *thread;
+
+    DEBUG(dbgThread, "Boosting all threads to level 0");
+    for (int i = 1; i < MLFQLevels; i++) {
+	while (!levels[i]->IsEmpty()) {
+	    thread = levels[i]->RemoveFront();
+	    thread->setLevel(0);
+	    thread->setQuantumUsed(0);
+	    levels[0]->Append(thread);
+	}
+    }
+    for (ListIterator<Thread *> it(levels[0]); !it.IsDone(); it.Next())
+	it.Item()->setQuantumUsed(0);
+    levelMask = levels[0]->IsEmpty() ? 0 : 1;
+    kernel->currentThread->setLevel(0);
+    kernel->currentThread->setQuantumUsed(0);
+}
+
 //----------------------------------------------------------------------
 // Scheduler::Run
 // 	Dispatch the CPU to nextThread.  Save the state of the old thread,
@@ -141,6 +633,23 @@ Scheduler::Run (Thread *nextThread, bool finishing)
          ASSERT(toBeDestroyed == NULL);
 	 toBeDestroyed = oldThread;
     }
+
+    if (oldThread->getStatus() != READY)	// blocking or finishing
+	EndBurst(oldThread, TRUE);
+    if (finishing) {
+	kernel->stats->numThreadsFinished++;
+	kernel->stats->totalWaitTicks += oldThread->cpu.waitTicks;
+	kernel->stats->totalTurnaroundTicks += 
+		kernel->stats->totalTicks - oldThread->cpu.createdAt;
+    }
+    nextThread->cpu.waitTicks += 
+		kernel->stats->totalTicks - nextThread->cpu.readySince;
+    nextThread->cpu.dispatchedAt = kernel->stats->totalTicks;
+    if (nextThread->cpu.lastCpu >= 0 && nextThread->cpu.lastCpu != currentCpu)
+	kernel->stats->numMigrations++;
+    nextThread->cpu.lastCpu = currentCpu;
+    globalPass = nextThread->cpu.pass;
+    cpus[currentCpu].current = nextThread;
     
 #ifdef USER_PROGRAM			// ignore until running user programs 
     if (oldThread->space != NULL) {	// if this thread is a user program,
@@ -209,5 +718,396 @@ void
 Scheduler::Print()
 {
     cout << "Ready list contents:\n";
+    if (numCpus > 1) {
+	for (int i = 0; i < numCpus; i++) {
+	    cout << "Processor " << i << ": ";
+	    cpus[i].readyQueue->Apply(ThreadPrint);
+	    cout << "\n";
+	}
+	return;
+    }
+    if (readyHeap != NULL) {
+	readyHeap->Apply(ThreadPrint);
+	return;
+    }
+    if (schedulerType == MLFQ || schedulerType == Priority) {
+	for (int i = 0; i < NumPriorities; i++) {
+	    if (!levels[i]->IsEmpty()) {
+		cout << "Level " << i << ": ";
+		levels[i]->Apply(ThreadPrint);
+		cout << "\n";
+	    }
+	}
+	return;
+    }
     readyList->Apply(ThreadPrint);
 }
+
+//----------------------------------------------------------------------
+// CpuIdleLoop
+// 	What a processor's idle thread does: run whatever arrives on the
+//	processor's ready list, and when there is nothing, let the other
+//	processors run until something does.
+//----------------------------------------------------------------------
+
+static void
+CpuIdleLoop()
+{
+    Scheduler *scheduler = kernel->scheduler;
+    Thread *nextThread;
+
+    (void) kernel->interrupt->SetLevel(IntOff);
+    for (;;) {
+	nextThread = scheduler->FindNextToRun();
+	if (nextThread != NULL) {
+	    kernel->interrupt->ClearIPI(scheduler->CurrentCpu());
+	    scheduler->Run(nextThread, FALSE);
+	} else {
+	    scheduler->IdleCpu();
+	}
+    }
+}
+
+//----------------------------------------------------------------------
+// Scheduler::StartCpus
+// 	Turn the machine into a multiprocessor with "n" processors.
+//	The thread calling us keeps running on processor 0; the others
+//	start out idle.  Each processor gets its own ready list, which
+//	is kept in round robin order, so only the RR and FIFO schedulers
+//	are supported.
+//
+//	"n" is the number of processors
+//----------------------------------------------------------------------
+
+void
+Scheduler::StartCpus(int n)
+{
+    ASSERT(1 < n && n <= MaxCpus);
+    ASSERT(schedulerType == RR || schedulerType == FIFO);
+    ASSERT(readyList->IsEmpty());
+
+    for (int i = 0; i < n; i++) {
+	cpus[i].idleThread = new Thread("idle");
+	cpus[i].idleThread->Prepare((VoidFunctionPtr) CpuIdleLoop, NULL);
+	cpus[i].readyQueue = new Deque<Thread *>;
+	cpus[i].current = (i == 0) ? kernel->currentThread 
+					: cpus[i].idleThread;
+	cpus[i].idle = (i != 0);
+	cpus[i].clock = kernel->stats->totalTicks;
+	cpus[i].busyTicks = 0;
+	cpus[i].userMode = FALSE;
+    }
+    kernel->currentThread->cpu.lastCpu = 0;
+    numCpus = n;
+    currentCpu = 0;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::IdleThread
+// 	Return the idle thread of the processor being simulated, for a
+//	thread that is going to sleep with nothing else ready to run.
+//	On a uniprocessor there is none: the caller must wait for an
+//	interrupt itself.
+//----------------------------------------------------------------------
+
+Thread *
+Scheduler::IdleThread()
+{
+    if (numCpus == 1)
+	return NULL;
+    return cpus[currentCpu].idleThread;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::PickCpu
+// 	Decide which processor's ready list a thread goes on: the one
+//	it last ran on, to keep its cache warm, or for a new thread, the
+//	one with the least work.  A thread may ask for a processor with
+//	SetAffinity; that takes precedence.
+//----------------------------------------------------------------------
+
+int
+Scheduler::PickCpu(Thread *thread)
+{
+    int best = 0, load, bestLoad = -1;
+
+    if (thread->cpu.affinity >= 0)
+	return thread->cpu.affinity;
+    if (thread->cpu.lastCpu >= 0)
+	return thread->cpu.lastCpu;
+    for (int i = 0; i < numCpus; i++) {
+	load = cpus[i].readyQueue->NumInDeque() + (cpus[i].idle ? 0 : 1);
+	if (bestLoad < 0 || load < bestLoad) {
+	    best = i;
+	    bestLoad = load;
+	}
+    }
+    return best;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Steal
+// 	The processor being simulated has nothing on its ready queue:
+//	take a thread from the back of the longest queue of a busy
+//	processor, where the threads that have waited least are.  Idle
+//	processors are left alone, since they have already been asked to
+//	run their queues.  A thread that asked to run on its processor is
+//	not taken.  Returns NULL if there is nothing to steal.
+//----------------------------------------------------------------------
+
+Thread *
+Scheduler::Steal()
+{
+    int victim = -1;
+    Thread *thread;
+
+    for (int i = 0; i < numCpus; i++) {
+	if (i == currentCpu || cpus[i].idle || cpus[i].readyQueue->IsEmpty())
+	    continue;
+	if (cpus[i].readyQueue->Back()->cpu.affinity == i)
+	    continue;
+	if (victim < 0 || cpus[i].readyQueue->NumInDeque() 
+				> cpus[victim].readyQueue->NumInDeque())
+	    victim = i;
+    }
+    if (victim < 0)
+	return NULL;
+    thread = cpus[victim].readyQueue->RemoveBack();
+    DEBUG(dbgThread, "Processor " << currentCpu << " stealing " 
+	  << thread->getName() << " from processor " << victim);
+    kernel->stats->numSteals++;
+    return thread;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::WakeThief
+// 	A thread has been queued behind a busy processor.  If some
+//	processor is idle, interrupt it, so it can steal the thread (or
+//	another one) instead of waiting for work of its own.
+//----------------------------------------------------------------------
+
+void
+Scheduler::WakeThief()
+{
+    for (int i = 0; i < numCpus; i++) {
+	if (cpus[i].idle) {
+	    kernel->interrupt->SendIPI(i);
+	    return;
+	}
+    }
+}
+
+//----------------------------------------------------------------------
+// Scheduler::SetAffinity
+// 	Ask for "thread" to be run on processor "cpu", or on any
+//	processor if "cpu" is -1.  Only a hint: it takes effect the next
+//	time the thread becomes ready, and has no effect on a
+//	uniprocessor.  "cpu" must be one of the processors started.
+//----------------------------------------------------------------------
+
+void
+Scheduler::SetAffinity(Thread *thread, int cpu)
+{
+    ASSERT(cpu >= -1 && cpu < numCpus);
+    thread->cpu.affinity = cpu;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::ChargeTick
+// 	The processor being simulated has run for "ticks" more.  Return
+//	the new simulated time: as far as every busy processor has run.
+//	Time never goes backwards, so a processor that has just woken up
+//	starts from the current time.
+//----------------------------------------------------------------------
+
+int
+Scheduler::ChargeTick(int ticks)
+{
+    int now = -1;
+
+    cpus[currentCpu].clock += ticks;
+    cpus[currentCpu].busyTicks += ticks;
+    for (int i = 0; i < numCpus; i++) {
+	if (!cpus[i].idle && (now < 0 || cpus[i].clock < now))
+	    now = cpus[i].clock;
+    }
+    if (now < kernel->stats->totalTicks)
+	now = kernel->stats->totalTicks;
+    return now;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::NextCpu
+// 	Return the busy processor that is furthest behind, so the
+//	processors take turns a tick at a time.  Ties go to the next one
+//	after the current processor.  Returns -1 if every processor is
+//	idle.
+//----------------------------------------------------------------------
+
+int
+Scheduler::NextCpu()
+{
+    int best = -1, cpu;
+
+    for (int i = 1; i <= numCpus; i++) {
+	cpu = (currentCpu + i) % numCpus;
+	if (!cpus[cpu].idle && (best < 0 || cpus[cpu].clock < cpus[best].clock))
+	    best = cpu;
+    }
+    return best;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::SwitchCpu
+// 	Stop simulating this processor, and go on with processor "cpu".
+//	Both threads stay running on their processors; like Run, we save
+//	the state of the old one, and return once some processor
+//	switches back to this one.
+//
+//	"cpu" is the processor to simulate next
+//	"inUserMode" is TRUE if this processor was running user code,
+//		and will go on with it when we come back
+//----------------------------------------------------------------------
+
+void
+Scheduler::SwitchCpu(int cpu, bool inUserMode)
+{
+    Thread *oldThread = kernel->currentThread;
+    Thread *nextThread = cpus[cpu].current;
+
+    ASSERT(kernel->interrupt->getLevel() == IntOff);
+    ASSERT(cpu != currentCpu && !cpus[cpu].idle);
+
+#ifdef USER_PROGRAM
+    if (oldThread->space != NULL) {
+        oldThread->SaveUserState();
+	oldThread->space->SaveState();
+    }
+#endif
+    oldThread->CheckOverflow();
+
+    DEBUG(dbgThread, "Switching from processor " << currentCpu << " to " << cpu);
+    kernel->stats->numCpuSwitches++;
+    cpus[currentCpu].userMode = inUserMode;
+    currentCpu = cpu;
+    kernel->currentThread = nextThread;
+    SWITCH(oldThread, nextThread);
+
+    // we're back, running oldThread on its processor
+    ASSERT(kernel->interrupt->getLevel() == IntOff);
+    cpus[currentCpu].userMode = FALSE;
+
+#ifdef USER_PROGRAM
+    if (oldThread->space != NULL) {
+        oldThread->RestoreUserState();
+	oldThread->space->RestoreState();
+    }
+#endif
+}
+
+//----------------------------------------------------------------------
+// Scheduler::WakeCpu
+// 	Work may have arrived for processor "cpu".  If it was idle, put
+//	it back in the rotation, starting from the current time.
+//----------------------------------------------------------------------
+
+void
+Scheduler::WakeCpu(int cpu)
+{
+    if (!cpus[cpu].idle)
+	return;
+    cpus[cpu].idle = FALSE;
+    if (cpus[cpu].clock < kernel->stats->totalTicks)
+	cpus[cpu].clock = kernel->stats->totalTicks;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::IdleCpu
+// 	Called by a processor's idle thread when it has nothing to run.
+//	Let the busy processors run until one of them (or an interrupt)
+//	gives us work.  If no processor is busy, wait for an interrupt,
+//	as on a uniprocessor.
+//----------------------------------------------------------------------
+
+void
+Scheduler::IdleCpu()
+{
+    int cpu = currentCpu;
+    int next;
+
+    ASSERT(kernel->currentThread == cpus[cpu].idleThread);
+    cpus[cpu].idle = TRUE;
+    next = NextCpu();
+    if (next >= 0) {
+	SwitchCpu(next, FALSE);		// back when we've been woken up
+    } else {
+	kernel->interrupt->Idle();
+	WakeCpu(cpu);
+    }
+}
+
+//----------------------------------------------------------------------
+// Scheduler::PrintCpus
+// 	On a multiprocessor, print how much of the time each processor
+//	spent running threads.
+//----------------------------------------------------------------------
+
+void
+Scheduler::PrintCpus()
+{
+    int total = kernel->stats->totalTicks;
+
+    if (numCpus == 1 || total == 0)
+	return;
+    for (int i = 0; i < numCpus; i++) {
+	cout << "Processor " << i << ": busy " << cpus[i].busyTicks 
+	     << " ticks (" << (int) (100LL * cpus[i].busyTicks / total) 
+	     << "%)\n";
+    }
+}
+
+//----------------------------------------------------------------------
+// Scheduler::SelfTest, PreemptVictim
+// 	Under the Priority scheduler, test preemption on a timer
+//	interrupt: the running thread keeps the CPU while the only thread
+//	ready has a lower priority (a larger value), and gives it up once
+//	that thread's priority is higher than its own.
+//----------------------------------------------------------------------
+
+static bool victimRan;
+
+static void
+PreemptVictim(void *)
+{
+    victimRan = TRUE;
+}
+
+void
+Scheduler::SelfTest()
+{
+    Thread *current = kernel->currentThread;
+    Thread *victim;
+    IntStatus oldLevel;
+    int own;
+
+    if (schedulerType != Priority)
+	return;
+    victimRan = FALSE;
+    victim = new Thread("preempt victim");
+    victim->setPriority(NumPriorities - 1);
+
+    oldLevel = kernel->interrupt->SetLevel(IntOff);
+    victim->Fork((VoidFunctionPtr) PreemptVictim, NULL);
+    own = current->getPriority();
+    current->setPriority(1);
+    ASSERT(!TimerTick());		// 1 (now 2) is ahead of 30 or 31
+    ASSERT(current->getPriority() == 2);
+    SetPriority(victim, 0);
+    ASSERT(TimerTick());		// 0 is ahead of 3
+    SetPriority(victim, NumPriorities - 1);
+    current->setPriority(own);
+    (void) kernel->interrupt->SetLevel(oldLevel);
+
+    while (!victimRan)
+	kernel->currentThread->Yield();
+}
@@ -11,7 +11,11 @@
 
 #include "copyright.h"
 #include "list.h"
+#include "heap.h"
+#include "deque.h"
 #include "thread.h"
+#include "kerneltask.h"
+#include "interrupt.h"
 
 // The following class defines the scheduler/dispatcher abstraction -- 
 // the data structures and operations needed to keep track of which 
@@ -21,7 +25,86 @@ enum SchedulerType {
         RR,     // Round Robin
         SJF,
         Priority,
-		FIFO
+		FIFO,
+        MLFQ,   // Multi-level feedback queue
+        SRTF,   // Shortest remaining time first (preemptive SJF)
+        Stride, // Proportional share, deterministic
+        Lottery // Proportional share, randomized
+};
+
+// SJF and SRTF order the ready threads on a prediction of how long
+// their next CPU burst will be: an exponential average of the bursts
+// they have had so far, weighted BurstWeight / 4 towards the latest.
+// A new thread is predicted to run for its burstTime, if it was set,
+// and DefaultBurst ticks otherwise.
+
+const int BurstWeight = 2;		// out of 4
+const int DefaultBurst = 100;		// in ticks
+
+// Stride and Lottery give each thread a share of the CPU in proportion
+// to its tickets.  Under Stride, each thread's "pass" advances by
+// StrideOne / tickets for every tick it runs, and the thread with the
+// lowest pass runs next.  Under Lottery, the next thread is drawn at
+// random, weighted by tickets.
+
+const long long StrideOne = 1 << 20;
+const int MaxShareRecords = 32;		// threads the share report covers
+
+// What share of the CPU a thread asked for, and what it got.
+
+class ShareRecord {
+  public:
+    char *name;
+    int tickets;
+    int ticksRun;
+};
+
+// Multi-level feedback queue parameters.  Level 0 is the highest
+// priority; a thread that uses up its quantum drops one level, and
+// every MLFQBoostPeriod ticks all threads go back to level 0, so
+// that threads at the bottom can't starve.  The quantum doubles at
+// each level, and is counted in timer interrupts.
+
+const int MLFQLevels = 8;
+const int MLFQBoostPeriod = 5000;	// in ticks
+
+// Priority scheduling runs the thread with the smallest priority value
+// first, and keeps one ready queue per value, so a thread is put on,
+// taken off, or moved between queues without searching.  Values are
+// limited to 0..NumPriorities-1.  A thread that runs through a timer
+// interrupt drops one step; every AgingPeriod ticks, every thread still
+// waiting rises one step, so a waiting thread can't starve.
+
+const int NumPriorities = 32;		// must fit in the bits of levelMask
+const int AgingPeriod = 500;		// in ticks
+
+// On a simulated multiprocessor (-cpus N), each processor has its own
+// current thread and queue of ready threads.  Only one thread really
+// runs at a time: the simulation moves from processor to processor
+// after every tick, always to the one furthest behind in simulated
+// time (see Interrupt::OneTick), so they take turns.
+//
+// A processor with nothing to do runs its idle thread, which leaves
+// the processor out of the rotation until work arrives for it.
+//
+// A thread that becomes ready goes on the queue of the processor it
+// asked for (its affinity), else the one it last ran on, else the
+// least loaded one.  A processor runs its queue from the front; when
+// it is empty, it steals from the back of the longest queue of a busy
+// processor, and when a thread is queued behind a busy processor, an
+// idle one is woken up to do that.
+
+class CpuState {
+  public:
+    Thread *current;		// the thread this processor is running
+    Thread *idleThread;		// runs when there is nothing else
+    Deque<Thread *> *readyQueue;	// threads waiting for this processor
+    bool idle;			// nothing to run?
+    int clock;			// how far it has run, in ticks
+    int busyTicks;		// ticks spent running threads
+    bool userMode;		// suspended in the middle of running
+				// user code (so a ParallelRunner may
+				// run it for a while)
 };
 
 class Scheduler {
@@ -39,18 +122,114 @@ class Scheduler {
 	void CheckToBeDestroyed();	// Check if thread that had been
     					// running needs to be deleted
 	void Print();			// Print contents of ready list
+
+	bool TimerTick();		// Charge the current thread for a
+					// timer interrupt; TRUE if it should
+					// be preempted
+
+	void SetPriority(Thread *thread, int priority);
+					// Change a thread's priority, moving
+					// it if it is on the ready list
+	void SetInheritedPriority(Thread *thread, int priority);
+					// Same, for the priority it has
+					// inherited through its locks
+	void SetTickets(Thread *thread, int tickets);
+					// Change a thread's share of the CPU
+	void SetAffinity(Thread *thread, int cpu);
+					// Ask for a thread to run on "cpu"
+	void PrintShares();		// Under Stride or Lottery, print the
+					// share of the CPU each thread got
+	void Age();			// Under Priority, raise the priority
+					// of every waiting thread one step
+
+	void ReadyTask(KernelTask *task);	// task has been posted
+	void CancelTask(KernelTask *task);	// posted task is going away
+	bool RunTasks();		// run one step of each posted task;
+					// TRUE if there were any
+	bool InTask() { return runningTask != NULL; }
+					// is a task's step running?
+	bool HasTasks() { return !readyTasks->IsEmpty(); }
+					// has any task been posted?
+
+	void StartCpus(int n);		// Become a multiprocessor with "n"
+					// processors
+	int NumCpus() { return numCpus; }
+	int CurrentCpu() { return currentCpu; }
+					// the processor being simulated
+	bool IsCpuIdle(int cpu) { return cpus[cpu].idle; }
+	Thread *IdleThread();		// this processor's idle thread, or
+					// NULL on a uniprocessor
+	int ChargeTick(int ticks);	// this processor has run another
+					// tick; returns the time
+	void ChargeCpu(int cpu, int ticks) { cpus[cpu].clock += ticks;
+					     cpus[cpu].busyTicks += ticks; }
+					// processor "cpu" has run "ticks"
+					// more, on a host thread
+	int CpuClock(int cpu) { return cpus[cpu].clock; }
+	Thread *CpuThread(int cpu) { return cpus[cpu].current; }
+	bool IsCpuInUserMode(int cpu) { return cpus[cpu].userMode; }
+	int NextCpu();			// which processor to simulate next
+	void SwitchCpu(int cpu, bool inUserMode);
+					// move on to simulating "cpu";
+					// "inUserMode" if we were in the
+					// middle of running user code
+	void WakeCpu(int cpu);		// there may be work for "cpu"
+	void IdleCpu();			// nothing for this processor to do
+	void PrintCpus();		// print how busy each processor was
     	
     	void setSchedulerType(SchedulerType t) {schedulerType = t;}
 	SchedulerType getSchedulerType() {return schedulerType;}
 
-    // SelfTest for scheduler is implemented in class Thread
+	void SelfTest();		// test Priority preemption; the rest
+					// is tested by Thread::SelfTest
     
   private:
 	SchedulerType schedulerType;
 	List<Thread *> *readyList;	// queue of threads that are ready to run,
 					// but not running
+	Heap<Thread *> *readyHeap;	// for SJF and SRTF, shortest first;
+					// for Stride, lowest pass first
+	int readyTickets;		// for Lottery, tickets on readyList
+	long long globalPass;		// for Stride, pass of the thread
+					// dispatched last
+	ShareRecord shares[MaxShareRecords];
+	int numShares;
+	List<Thread *> *levels[NumPriorities];
+					// for MLFQ and Priority, one queue
+					// per level (priority)
+	unsigned int levelMask;		// bit i is set iff levels[i] is not
+					// empty, so the highest non-empty
+					// level can be found in one step
+	int nextBoost;			// when to next move every thread
+					// back to MLFQ level 0
+	int nextAging;			// when to next raise the priority
+					// of the waiting threads
+
+	int LevelOf(Thread *thread);	// queue in "levels" for "thread"
+	int HighestLevel();		// highest non-empty level, or
+					// NumPriorities if all are empty
+	void Boost();			// move every thread to MLFQ level 0
+	void Requeue(Thread *thread, int oldLevel);
+					// move a ready thread whose
+					// priority has changed
+	void EndBurst(Thread *thread, bool done);
+					// charge "thread" for the CPU it
+					// used since it was dispatched
 	Thread *toBeDestroyed;		// finishing thread to be destroyed
     					// by the next thread that runs
+	List<KernelTask *> *readyTasks;	// tasks posted but not yet run
+	KernelTask *runningTask;	// the task whose step is running
+
+	int numCpus;			// 1 unless StartCpus was called
+	int currentCpu;			// processor kernel->currentThread
+					// is running on
+	CpuState cpus[MaxCpus];
+	int PickCpu(Thread *thread);	// which processor should run a
+					// thread that has become ready
+	Thread *Steal();		// take a thread from the back of the
+					// longest queue of a busy processor
+	void WakeThief();		// give an idle processor the chance
+					// to steal
 };
 
 #endif // SCHEDULER_H
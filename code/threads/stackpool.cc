@@ -0,0 +1,135 @@
+// stackpool.cc
+//	Routines to recycle thread execution stacks.  See stackpool.h.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "stackpool.h"
+#include "main.h"
+#include "sysdep.h"
+
+//----------------------------------------------------------------------
+// StackPool::StackPool
+// 	Initialize an empty pool.
+//
+//	"smallest" -- words in a stack of the smallest class
+//	"maxFree" -- most stacks to keep in each class
+//----------------------------------------------------------------------
+
+StackPool::StackPool(int smallest, int maxFree)
+{
+    ASSERT(smallest > 0 && maxFree >= 0);
+
+    this->maxFree = maxFree;
+    for (int i = 0; i < NumStackClasses; i++) {
+	classSize[i] = smallest << i;
+	freeStacks[i] = (maxFree > 0) ? new int *[maxFree] : NULL;
+	numFree[i] = 0;
+    }
+}
+
+//----------------------------------------------------------------------
+// StackPool::~StackPool
+// 	Give back to the host the stacks we have been keeping.
+//----------------------------------------------------------------------
+
+StackPool::~StackPool()
+{
+    for (int i = 0; i < NumStackClasses; i++) {
+	for (int j = 0; j < numFree[i]; j++)
+	    DeallocLazyArray((char *) freeStacks[i][j],
+					classSize[i] * sizeof(int));
+	delete [] freeStacks[i];
+    }
+}
+
+//----------------------------------------------------------------------
+// StackPool::ClassOf
+// 	Return the smallest class whose stacks have at least "size"
+//	words, or -1 if there is none.
+//----------------------------------------------------------------------
+
+int
+StackPool::ClassOf(int size)
+{
+    for (int i = 0; i < NumStackClasses; i++) {
+	if (size <= classSize[i])
+	    return i;
+    }
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// StackPool::Allocate
+// 	Return a stack with room for at least "*size" words, with its
+//	guard pages in place: one we have kept if there is one, or else
+//	a new one.  "*size" is set to the size of the stack returned,
+//	which must be passed back to Free.
+//----------------------------------------------------------------------
+
+int *
+StackPool::Allocate(int *size)
+{
+    int c = ClassOf(*size);
+
+    ASSERT(*size > 0);
+    if (c < 0)
+	return (int *) AllocLazyArray(*size * sizeof(int));
+    *size = classSize[c];
+    if (numFree[c] > 0) {
+	kernel->stats->numStacksReused++;
+	return freeStacks[c][--numFree[c]];
+    }
+    kernel->stats->numStacksAllocated++;
+    return (int *) AllocLazyArray(*size * sizeof(int));
+}
+
+//----------------------------------------------------------------------
+// StackPool::Free
+// 	"stack", of "size" words, is no longer in use.  Keep it for the
+//	next thread, unless we already have enough of its size.  The
+//	caller must have cleared whatever it wrote, except perhaps the
+//	fencepost word.
+//----------------------------------------------------------------------
+
+void
+StackPool::Free(int *stack, int size)
+{
+    int c = ClassOf(size);
+
+    if (c >= 0 && size == classSize[c] && numFree[c] < maxFree)
+	freeStacks[c][numFree[c]++] = stack;
+    else
+	DeallocLazyArray((char *) stack, size * sizeof(int));
+}
+
+//----------------------------------------------------------------------
+// StackPool::SelfTest
+// 	Test whether the pool is working: a stack that is freed is the
+//	next one handed out, sizes are rounded up to a class, and stacks
+//	larger than every class still work.
+//----------------------------------------------------------------------
+
+void
+StackPool::SelfTest()
+{
+    int size = classSize[0] + 1;
+    int *stack = Allocate(&size);
+
+    ASSERT(size == classSize[1]);
+    ASSERT(stack[1] == 0 && stack[size - 2] == 0);	// all of it is
+							// usable, and clear
+    Free(stack, size);
+    if (maxFree > 0) {
+	size = classSize[1];
+	ASSERT(Allocate(&size) == stack);
+	Free(stack, size);
+    }
+
+    size = classSize[NumStackClasses - 1] + 1;
+    stack = Allocate(&size);
+    ASSERT(size == classSize[NumStackClasses - 1] + 1);
+    Free(stack, size);
+}
@@ -0,0 +1,59 @@
+// stackpool.h
+//	Data structures to recycle thread execution stacks.
+//
+//	Allocating a stack means reserving host memory and protecting the
+//	pages on either side of it (see AllocLazyArray), and freeing one
+//	undoes all that.  A kernel that forks many short-lived threads
+//	spends much of its time doing this, so instead we keep the stacks
+//	of threads that have finished, guard pages and all, and hand them
+//	to the next threads that are forked.
+//
+//	Every stack handed out is all zeros, so a thread can tell how
+//	much of it has been used (see Thread::StackUsed).  New stacks
+//	start that way, and a thread clears the part it used before
+//	giving its stack back.
+//
+//	Stacks come in a few size classes, each twice the size of the
+//	one before; a request is rounded up to the smallest class that
+//	fits, and each class keeps at most "maxFree" stacks.  Requests
+//	larger than the largest class are allocated and freed directly.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef STACKPOOL_H
+#define STACKPOOL_H
+
+#include "copyright.h"
+
+const int NumStackClasses = 4;		// size classes
+const int DefaultMaxFreeStacks = 16;	// stacks kept per class
+
+class StackPool {
+  public:
+    StackPool(int smallest, int maxFree);
+				// Size classes start at "smallest" words;
+				// keep up to "maxFree" stacks per class
+				// (0 keeps none)
+    ~StackPool();		// Free the stacks we are keeping
+
+    int *Allocate(int *size);	// Return a stack of at least "*size"
+				// words, and set "*size" to its real size
+    void Free(int *stack, int size);
+				// A stack (of the size Allocate said) is
+				// no longer in use
+
+    void SelfTest();		// test whether the pool is working
+
+  private:
+    int ClassOf(int size);	// class a stack of "size" words is in,
+				// or -1 if it is larger than all of them
+
+    int classSize[NumStackClasses];	// words in a stack of each class
+    int **freeStacks[NumStackClasses];	// stacks kept, per class
+    int numFree[NumStackClasses];	// how many
+    int maxFree;
+};
+
+#endif // STACKPOOL_H
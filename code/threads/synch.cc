@@ -16,17 +16,28 @@
 // re-set the interrupt state back to its original value (whether
 // that be disabled or enabled).
 //
-// Once we'e implemented one set of higher level atomic operations,
-// we can implement others using that implementation.  We illustrate
-// this by implementing locks and condition variables on top of 
-// semaphores, instead of directly enabling and disabling interrupts.
+// Locks and condition variables are implemented the same way,
+// directly on queues of waiting threads, so that they can pass
+// threads from one queue to the other:
 //
-// Locks are implemented using a semaphore to keep track of
-// whether the lock is held or not -- a semaphore value of 0 means
-// the lock is busy; a semaphore value of 1 means the lock is free.
+// Locks are handed over: a thread releasing a lock that others are
+// waiting for gives it straight to the first of them, rather than
+// freeing it and letting the waiter try again (and perhaps lose it
+// to someone else, and go back to sleep).
 //
-// The implementation of condition variables using semaphores is
-// a bit trickier, as explained below under Condition::Wait.
+// A thread signalled on a condition variable could not run anyway
+// until the signaller releases the lock, so rather than waking it,
+// Signal moves it from the condition's queue to the lock's queue
+// ("wait morphing"), and it is woken when the lock is handed to it.
+// See Condition::Wait.
+//
+// Under the Priority scheduler, locks also pass on priorities: a
+// thread that has to wait for a lock lends its priority to the holder
+// (and, if the holder is itself waiting for a lock, to that lock's
+// holder, and so on), so that threads of middling priority can't keep
+// the holder -- and so the waiter -- from running.  The holder keeps
+// the best priority of the threads waiting for any of its locks, and
+// the lock is handed to the best of them.  See Lock::Donate.
 //
 // Copyright (c) 1992-1996 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -163,17 +174,27 @@ Semaphore::SelfTest()
 Lock::Lock(char* debugName)
 {
     name = debugName;
-    semaphore = new Semaphore("lock", 1);  // initially, unlocked
-    lockHolder = NULL;
+    lockHolder = NULL;			// initially, unlocked
+    queue = new List<Thread *>;
+    nextHeld = NULL;
 }
 
 //----------------------------------------------------------------------
 // Lock::~Lock
-// 	Deallocate a lock
+// 	Deallocate a lock.  Assume no one is still waiting for it!
+//	If it is still held, the holder forgets it holds it.
 //----------------------------------------------------------------------
 Lock::~Lock()
 {
-    delete semaphore;
+    if (lockHolder != NULL) {
+	Lock **held;
+
+	for (held = &lockHolder->locksHeld; *held != this; 
+					held = &(*held)->nextHeld)
+	    ASSERT(*held != NULL);
+	*held = nextHeld;
+    }
+    delete queue;
 }
 
 char*
@@ -181,25 +202,54 @@ Lock::getName()
 {
 	return name;
 }
+//----------------------------------------------------------------------
+// Inheriting
+//	Do locks pass on the priorities of the threads waiting for them?
+//	Only the Priority scheduler pays attention to them.
+//----------------------------------------------------------------------
+
+static bool
+Inheriting()
+{
+    return kernel->scheduler->getSchedulerType() == Priority;
+}
+
 //----------------------------------------------------------------------
 // Lock::Acquire
 //	Atomically wait until the lock is free, then set it to busy.
-//	Equivalent to Semaphore::P(), with the semaphore value of 0
-//	equal to busy, and semaphore value of 1 equal to free.
+//	If it is busy, we lend our priority to the holder, and sleep
+//	until the holder hands the lock to us in Release, so when we
+//	wake up, it is already ours.
 //----------------------------------------------------------------------
 
 void Lock::Acquire()
 {
-    semaphore->P();
-    lockHolder = kernel->currentThread;
+    Thread *currentThread = kernel->currentThread;
+    IntStatus oldLevel = kernel->interrupt->SetLevel(IntOff);
+
+    ASSERT(!IsHeldByCurrentThread());
+    if (lockHolder == NULL) {
+	GiveTo(currentThread);
+    } else {
+	queue->Append(currentThread);
+	currentThread->waitingFor = this;
+	if (Inheriting())
+	    Donate(currentThread->getEffectivePriority());
+	currentThread->Sleep(FALSE);
+	ASSERT(IsHeldByCurrentThread());
+    }
+    (void) kernel->interrupt->SetLevel(oldLevel);
 }
 
 //----------------------------------------------------------------------
 // Lock::Release
-//	Atomically set lock to be free, waking up a thread waiting
-//	for the lock, if any.
-//	Equivalent to Semaphore::V(), with the semaphore value of 0
-//	equal to busy, and semaphore value of 1 equal to free.
+//	Atomically give the lock to the thread that has waited longest
+//	for it (or under the Priority scheduler, the one with the
+//	highest priority), and make that thread ready; or if no one is
+//	waiting, set the lock to be free.
+//
+//	We give up whatever priority the threads still waiting for the
+//	lock had lent us; the new holder inherits it instead.
 //
 //	By convention, only the thread that acquired the lock
 // 	may release it.
@@ -207,9 +257,206 @@ void Lock::Acquire()
 
 void Lock::Release()
 {
+    Thread *currentThread = kernel->currentThread;
+    IntStatus oldLevel = kernel->interrupt->SetLevel(IntOff);
+    Lock **held;
+    Thread *next;
+
     ASSERT(IsHeldByCurrentThread());
+    for (held = &currentThread->locksHeld; *held != this; 
+					held = &(*held)->nextHeld)
+	ASSERT(*held != NULL);
+    *held = nextHeld;			// we no longer hold it
     lockHolder = NULL;
-    semaphore->V();
+    if (Inheriting())
+	kernel->scheduler->SetInheritedPriority(currentThread, 
+						Inheritance(currentThread));
+
+    if (!queue->IsEmpty()) {
+	next = NextWaiter();
+	next->waitingFor = NULL;
+	GiveTo(next);
+	if (Inheriting())
+	    kernel->scheduler->SetInheritedPriority(next, Inheritance(next));
+	kernel->scheduler->ReadyToRun(next);
+    }
+    (void) kernel->interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// Lock::Enqueue
+//	Put "thread", which is asleep, at the back of the queue of
+//	threads waiting for the lock, as if it had called Acquire.
+//	Used by Condition::Signal; the lock must be held, so "thread"
+//	will be woken up by a Release.
+//---------------------------------------------------------------------
+
+void Lock::Enqueue(Thread *thread)
+{
+    IntStatus oldLevel = kernel->interrupt->SetLevel(IntOff);
+
+    ASSERT(lockHolder != NULL && lockHolder != thread);
+    queue->Append(thread);
+    thread->waitingFor = this;
+    if (Inheriting())
+	Donate(thread->getEffectivePriority());
+    (void) kernel->interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// Lock::GiveTo
+//	Make "thread" the holder of the lock, and add the lock to the
+//	ones it holds.  Called with interrupts disabled.
+//---------------------------------------------------------------------
+
+void Lock::GiveTo(Thread *thread)
+{
+    lockHolder = thread;
+    nextHeld = thread->locksHeld;
+    thread->locksHeld = this;
+}
+
+//----------------------------------------------------------------------
+// Lock::NextWaiter
+//	Remove and return the thread to hand the lock to: the first in
+//	the queue, or under the Priority scheduler, the first of those
+//	with the highest priority.  Called with interrupts disabled.
+//---------------------------------------------------------------------
+
+Thread *Lock::NextWaiter()
+{
+    Thread *best = queue->Front();
+
+    if (Inheriting()) {
+	for (ListIterator<Thread *> it(queue); !it.IsDone(); it.Next()) {
+	    if (it.Item()->getEffectivePriority() < 
+					best->getEffectivePriority())
+		best = it.Item();
+	}
+    }
+    queue->Remove(best);
+    return best;
+}
+
+//----------------------------------------------------------------------
+// Lock::Donate
+//	A thread of priority "priority" is waiting for the lock: lend
+//	that priority to the holder, if it is higher than the holder's,
+//	and on down the chain, if the holder is waiting for another
+//	lock.  We can stop at the first holder that already runs at
+//	"priority" or better, since those after it must, too.
+//	Called with interrupts disabled.
+//---------------------------------------------------------------------
+
+void Lock::Donate(int priority)
+{
+    Thread *holder;
+
+    for (Lock *lock = this; lock != NULL; lock = holder->waitingFor) {
+	holder = lock->lockHolder;
+	if (holder == NULL || holder->getEffectivePriority() <= priority)
+	    break;
+	DEBUG(dbgSynch, "Lock " << lock->name << ": " << holder->getName()
+	      << " inherits priority " << priority);
+	kernel->scheduler->SetInheritedPriority(holder, priority);
+    }
+}
+
+//----------------------------------------------------------------------
+// Lock::Inheritance
+//	Return the priority "thread" should inherit: the best priority
+//	among the threads waiting for the locks it holds, or
+//	NotInherited if there are none.  Called with interrupts disabled.
+//---------------------------------------------------------------------
+
+int Lock::Inheritance(Thread *thread)
+{
+    int best = NotInherited;
+
+    for (Lock *lock = thread->locksHeld; lock != NULL; lock = lock->nextHeld) {
+	for (ListIterator<Thread *> it(lock->queue); !it.IsDone(); it.Next()) {
+	    if (it.Item()->getEffectivePriority() < best)
+		best = it.Item()->getEffectivePriority();
+	}
+    }
+    return best;
+}
+
+//----------------------------------------------------------------------
+// Lock::SelfTest, InheritHolder, InheritWaiter
+// 	Under the Priority scheduler, test priority inheritance: a
+//	low-priority holder is lent a waiter's priority, ages while it is
+//	ready to run, and goes back to its own (aged) priority when it
+//	releases the lock -- aging must not have turned the priority it
+//	was lent into its own.
+//----------------------------------------------------------------------
+
+static Lock *inheritLock;
+static Semaphore *inheritHeld, *inheritGo, *inheritDone;
+static const int HolderPriority = 20, WaiterPriority = 2;
+
+static void
+InheritHolder(void *)
+{
+    Thread *currentThread = kernel->currentThread;
+
+    inheritLock->Acquire();
+    inheritHeld->V();
+    inheritGo->P();			// waiter arrives, and we age
+    inheritLock->Release();
+    ASSERT(currentThread->cpu.inherited == NotInherited);
+    ASSERT(currentThread->getPriority() > WaiterPriority);
+    inheritDone->V();
+}
+
+static void
+InheritWaiter(void *)
+{
+    inheritLock->Acquire();
+    inheritLock->Release();
+    inheritDone->V();
+}
+
+void
+Lock::SelfTest()
+{
+    Thread *holder, *waiter;
+    IntStatus oldLevel;
+    int own;
+
+    if (!Inheriting())
+	return;
+    inheritLock = new Lock("inherit");
+    inheritHeld = new Semaphore("inherit held", 0);
+    inheritGo = new Semaphore("inherit go", 0);
+    inheritDone = new Semaphore("inherit done", 0);
+
+    holder = new Thread("holder");
+    holder->setPriority(HolderPriority);
+    holder->Fork((VoidFunctionPtr) InheritHolder, NULL);
+    inheritHeld->P();
+
+    waiter = new Thread("waiter");
+    waiter->setPriority(WaiterPriority);
+    waiter->Fork((VoidFunctionPtr) InheritWaiter, NULL);
+    while (holder->cpu.inherited == NotInherited)
+	kernel->currentThread->Yield();	// until the waiter is waiting
+    ASSERT(holder->getEffectivePriority() == WaiterPriority);
+
+    oldLevel = kernel->interrupt->SetLevel(IntOff);
+    inheritGo->V();			// the holder is ready, at the
+    own = holder->getPriority();	// waiter's priority
+    kernel->scheduler->Age();
+    ASSERT(holder->getPriority() == own - 1);
+    ASSERT(holder->getEffectivePriority() == WaiterPriority);
+    (void) kernel->interrupt->SetLevel(oldLevel);
+
+    inheritDone->P();
+    inheritDone->P();
+    delete inheritLock;
+    delete inheritHeld;
+    delete inheritGo;
+    delete inheritDone;
 }
 
 bool
@@ -228,7 +475,7 @@ Lock::IsHeldByCurrentThread()
 Condition::Condition(char* debugName)
 {
     name = debugName;
-    waitQueue = new List<Semaphore *>;
+    waitQueue = new List<Thread *>;
 }
 
 //----------------------------------------------------------------------
@@ -249,35 +496,38 @@ Condition::getName()
 //----------------------------------------------------------------------
 // Condition::Wait
 // 	Atomically release monitor lock and go to sleep.
-//	Our implementation uses semaphores to implement this, by
-//	allocating a semaphore for each waiting thread.  The signaller
-//	will V() this semaphore, so there is no chance the waiter
-//	will miss the signal, even though the lock is released before
-//	calling P().
+//	We put ourselves on the condition's queue and release the lock
+//	with interrupts disabled, so there is no chance that we miss
+//	the signal.  The signaller moves us to the lock's queue, and the
+//	lock is handed to us when it is our turn, so when we wake up we
+//	already hold the lock again.
 //
-//	Note: we assume Mesa-style semantics, which means that the
-//	waiter must re-acquire the monitor lock when waking up.
+//	Note: we assume Mesa-style semantics, which means that other
+//	threads may get the lock, and change things, between the signal
+//	and when we run again.
 //
 //	"conditionLock" -- lock protecting the use of this condition
 //----------------------------------------------------------------------
 
 void Condition::Wait(Lock* conditionLock) 
 {
-     Semaphore *waiter;
-    
-     ASSERT(conditionLock->IsHeldByCurrentThread());
-
-     waiter = new Semaphore("condition", 0);
-     waitQueue->Append(waiter);
-     conditionLock->Release();
-     waiter->P();
-     conditionLock->Acquire();
-     delete waiter;
+    Thread *currentThread = kernel->currentThread;
+    IntStatus oldLevel = kernel->interrupt->SetLevel(IntOff);
+
+    ASSERT(conditionLock->IsHeldByCurrentThread());
+
+    waitQueue->Append(currentThread);
+    conditionLock->Release();
+    currentThread->Sleep(FALSE);
+    ASSERT(conditionLock->IsHeldByCurrentThread());
+    (void) kernel->interrupt->SetLevel(oldLevel);
 }
 
 //----------------------------------------------------------------------
 // Condition::Signal
-// 	Wake up a thread waiting on this condition, if any.
+// 	Wake up a thread waiting on this condition, if any.  The thread
+//	couldn't run until we release the monitor lock anyway, so it
+//	isn't made ready: it is moved to the queue for the lock.
 //
 //	Note: we assume Mesa-style semantics, which means that the
 //	signaller doesn't give up control immediately to the thread
@@ -292,13 +542,10 @@ void Condition::Wait(Lock* conditionLock)
 
 void Condition::Signal(Lock* conditionLock)
 {
-    Semaphore *waiter;
-    
     ASSERT(conditionLock->IsHeldByCurrentThread());
     
     if (!waitQueue->IsEmpty()) {
-        waiter = waitQueue->RemoveFront();
-	waiter->V();
+	conditionLock->Enqueue(waitQueue->RemoveFront());
     }
 }
 
@@ -65,6 +65,11 @@ class Semaphore {
 // In addition, by convention, only the thread that acquired the lock
 // may release it.  As with semaphores, you can't read the lock value
 // (because the value might change immediately after you read it).  
+//
+// A lock that is released while threads are waiting for it goes
+// straight to the one that has waited longest.  Under the Priority
+// scheduler, it goes to the one with the highest priority instead,
+// and while threads wait, the holder inherits their priority.
 
 class Lock {
   public:
@@ -79,12 +84,25 @@ class Lock {
     				// return true if the current thread 
 				// holds this lock.
     
-    // Note: SelfTest routine provided by SynchList
+    static void SelfTest();	// test priority inheritance; the rest
+				// is tested by SynchList
     
   private:
     char *name;			// debugging assist
     Thread *lockHolder;		// thread currently holding lock
-    Semaphore *semaphore;	// we use a semaphore to implement lock
+    List<Thread *> *queue;	// threads waiting in Acquire()
+    Lock *nextHeld;		// next lock held by "lockHolder"
+
+    friend class Condition;
+    void Enqueue(Thread *thread);	// make a signalled thread wait for
+					// the lock, as if in Acquire()
+    void GiveTo(Thread *thread);	// make "thread" the holder
+    Thread *NextWaiter();		// take the next holder off "queue"
+    void Donate(int priority);		// lend "priority" to the holder,
+					// and to whoever it is waiting on
+    static int Inheritance(Thread *thread);
+					// priority "thread" inherits from
+					// the waiters for its locks
 };
 
 // The following class defines a "condition variable".  A condition
@@ -107,9 +125,9 @@ class Lock {
 //
 // In Nachos, condition variables are assumed to obey *Mesa*-style
 // semantics.  When a Signal or Broadcast wakes up another thread,
-// it simply puts the thread on the ready list, and it is the responsibility
-// of the woken thread to re-acquire the lock (this re-acquire is
-// taken care of within Wait()).  By contrast, some define condition
+// the thread must still re-acquire the lock before it can return from
+// Wait(); here, Signal simply moves it to the queue of threads waiting
+// for the lock, and it runs once the lock is handed to it.  By contrast, some define condition
 // variables according to *Hoare*-style semantics -- where the signalling
 // thread gives up control over the lock and the CPU to the woken thread,
 // which runs immediately and gives back control over the lock to the 
@@ -138,6 +156,6 @@ class Condition {
 
   private:
     char* name;
-    List<Semaphore *> *waitQueue;	// list of waiting threads
+    List<Thread *> *waitQueue;		// list of waiting threads
 };
 #endif // SYNCH_H
@@ -31,14 +31,34 @@ const int STACK_FENCEPOST = 0xdedbeef;
 //	Thread::Fork.
 //
 //	"threadName" is an arbitrary string, useful for debugging.
+//	"stackWords" is how big its stack must be, in words.  Stacks are
+//		only reserved; a page is only allocated when the thread
+//		first uses it, so a generous size costs little.
 //----------------------------------------------------------------------
 
-Thread::Thread(char* threadName)
+Thread::Thread(char* threadName, int stackWords)
 {
+    ASSERT(stackWords >= MinStackSize);
     name = threadName;
     stackTop = NULL;
     stack = NULL;
+    stackSize = stackWords;
     status = JUST_CREATED;
+    burstTime = 0;
+    priority = 0;
+    level = 0;
+    quantumUsed = 0;
+    cpu.predictedBurst = cpu.burstUsed = 0;
+    cpu.dispatchedAt = cpu.readySince = cpu.createdAt = 0;
+    cpu.waitTicks = 0;
+    cpu.tickets = DefaultTickets;
+    cpu.pass = 0;
+    cpu.shareSlot = -1;
+    cpu.lastCpu = -1;
+    cpu.affinity = -1;
+    cpu.inherited = NotInherited;
+    waitingFor = NULL;
+    locksHeld = NULL;
     for (int i = 0; i < MachineStateSize; i++) {
 	machineState[i] = NULL;		// not strictly necessary, since
 					// new thread ignores contents 
@@ -66,8 +86,59 @@ Thread::~Thread()
     DEBUG(dbgThread, "Deleting thread: " << name);
 
     ASSERT(this != kernel->currentThread);
-    if (stack != NULL)
-	DeallocBoundedArray((char *) stack, StackSize * sizeof(int));
+    if (stack != NULL) {
+	int used = StackUsed();
+
+	DEBUG(dbgThread, "Thread " << name << " used " << used << " of " 
+	      << stackSize << " words of stack");
+	if (used > kernel->stats->maxStackUsed)
+	    kernel->stats->maxStackUsed = used;
+#ifdef PARISC
+	bzero((char *) stack, used * sizeof(int));
+#else
+	bzero((char *) &stack[stackSize - used], used * sizeof(int));
+#endif
+	kernel->stackPool->Free(stack, stackSize);
+    }
+}
+
+//----------------------------------------------------------------------
+// Thread::operator new, Thread::operator delete
+// 	Allocate and free the memory for Thread objects.  The memory of
+//	a thread that has been deleted (usually by the next thread to
+//	run, in Scheduler::CheckToBeDestroyed) goes on a free list, up to
+//	MaxFreeThreads of them, and the next Thread created gets it back
+//	without going to the host's allocator.
+//
+//	The free list is threaded through the first word of each block.
+//----------------------------------------------------------------------
+
+static void *freeThreads = NULL;	// deleted Thread objects
+static int numFreeThreads = 0;
+
+void *
+Thread::operator new(size_t size)
+{
+    void *p;
+
+    if (size != sizeof(Thread) || freeThreads == NULL)
+	return ::operator new(size);
+    p = freeThreads;
+    freeThreads = *(void **) p;
+    numFreeThreads--;
+    return p;
+}
+
+void
+Thread::operator delete(void *p)
+{
+    if (numFreeThreads == MaxFreeThreads) {
+	::operator delete(p);
+	return;
+    }
+    *(void **) p = freeThreads;
+    freeThreads = p;
+    numFreeThreads++;
 }
 
 //----------------------------------------------------------------------
@@ -107,6 +178,23 @@ Thread::Fork(VoidFunctionPtr func, void *arg)
     (void) interrupt->SetLevel(oldLevel);
 }    
 
+//----------------------------------------------------------------------
+// Thread::Prepare
+// 	Like Fork, but don't put the thread on the ready list: the
+//	scheduler uses this for threads it switches to itself, like the
+//	idle thread of each processor.
+//
+//	"func" is the procedure to run concurrently.
+//	"arg" is a single argument to be passed to the procedure.
+//----------------------------------------------------------------------
+
+void 
+Thread::Prepare(VoidFunctionPtr func, void *arg)
+{
+    DEBUG(dbgThread, "Preparing thread: " << name);
+    StackAllocate(func, arg);
+}
+
 //----------------------------------------------------------------------
 // Thread::CheckOverflow
 // 	Check a thread's stack to see if it has overrun the space
@@ -127,13 +215,39 @@ Thread::CheckOverflow()
 {
     if (stack != NULL) {
 #ifdef HPUX			// Stacks grow upward on the Snakes
-	ASSERT(stack[StackSize - 1] == STACK_FENCEPOST);
+	ASSERT(stack[stackSize - 1] == STACK_FENCEPOST);
 #else
 	ASSERT(*stack == STACK_FENCEPOST);
 #endif
    }
 }
 
+//----------------------------------------------------------------------
+// Thread::StackUsed
+// 	Return how many words of its stack the thread has used, at the
+//	deepest: how far from the top the last word that isn't zero is.
+//	A stack starts out all zeros (see StackPool), so this is exact
+//	unless the deepest words the thread wrote happened to be zero.
+//----------------------------------------------------------------------
+
+int
+Thread::StackUsed()
+{
+    int i;
+
+    if (stack == NULL)
+	return 0;
+#ifdef PARISC			// grows upward; the fencepost is at the top
+    for (i = stackSize - 2; i >= 0 && stack[i] == 0; i--)
+	;
+    return i + 1;
+#else				// the fencepost is stack[0]
+    for (i = 1; i < stackSize && stack[i] == 0; i++)
+	;
+    return stackSize - i;
+#endif
+}
+
 //----------------------------------------------------------------------
 // Thread::Begin
 // 	Called by ThreadRoot when a thread is about to begin
@@ -207,6 +321,7 @@ Thread::Yield ()
     IntStatus oldLevel = kernel->interrupt->SetLevel(IntOff);
     
     ASSERT(this == kernel->currentThread);
+    ASSERT(!kernel->scheduler->InTask());
     
     DEBUG(dbgThread, "Yielding thread: " << name);
     
@@ -245,12 +360,17 @@ Thread::Sleep (bool finishing)
     
     ASSERT(this == kernel->currentThread);
     ASSERT(kernel->interrupt->getLevel() == IntOff);
+    ASSERT(!kernel->scheduler->InTask());	// tasks must never wait
     
     DEBUG(dbgThread, "Sleeping thread: " << name);
 
     status = BLOCKED;
-    while ((nextThread = kernel->scheduler->FindNextToRun()) == NULL)
+    while ((nextThread = kernel->scheduler->FindNextToRun()) == NULL) {
+	nextThread = kernel->scheduler->IdleThread();
+	if (nextThread != NULL)		// on a multiprocessor, the idle
+	    break;			// thread waits for us
 	kernel->interrupt->Idle();	// no one to run, wait for an interrupt
+    }
     
     // returns when it's time for us to run
     kernel->scheduler->Run(nextThread, finishing); 
@@ -307,34 +427,34 @@ PLabelToAddr(void *plabel)
 void
 Thread::StackAllocate (VoidFunctionPtr func, void *arg)
 {
-    stack = (int *) AllocBoundedArray(StackSize * sizeof(int));
+    stack = kernel->stackPool->Allocate(&stackSize);
 
 #ifdef PARISC
     // HP stack works from low addresses to high addresses
     // everyone else works the other way: from high addresses to low addresses
     stackTop = stack + 16;	// HP requires 64-byte frame marker
-    stack[StackSize - 1] = STACK_FENCEPOST;
+    stack[stackSize - 1] = STACK_FENCEPOST;
 #endif
 
 #ifdef SPARC
-    stackTop = stack + StackSize - 96; 	// SPARC stack must contains at 
+    stackTop = stack + stackSize - 96; 	// SPARC stack must contains at 
 					// least 1 activation record 
 					// to start with.
     *stack = STACK_FENCEPOST;
 #endif 
 
 #ifdef PowerPC // RS6000
-    stackTop = stack + StackSize - 16; 	// RS6000 requires 64-byte frame marker
+    stackTop = stack + stackSize - 16; 	// RS6000 requires 64-byte frame marker
     *stack = STACK_FENCEPOST;
 #endif 
 
 #ifdef DECMIPS
-    stackTop = stack + StackSize - 4;	// -4 to be on the safe side!
+    stackTop = stack + stackSize - 4;	// -4 to be on the safe side!
     *stack = STACK_FENCEPOST;
 #endif
 
 #ifdef ALPHA
-    stackTop = stack + StackSize - 8;	// -8 to be on the safe side!
+    stackTop = stack + stackSize - 8;	// -8 to be on the safe side!
     *stack = STACK_FENCEPOST;
 #endif
 
@@ -343,7 +463,7 @@ Thread::StackAllocate (VoidFunctionPtr func, void *arg)
     // the x86 passes the return address on the stack.  In order for SWITCH() 
     // to go to ThreadRoot when we switch to this thread, the return addres 
     // used in SWITCH() must be the starting address of ThreadRoot.
-    stackTop = stack + StackSize - 4;	// -4 to be on the safe side!
+    stackTop = stack + stackSize - 4;	// -4 to be on the safe side!
     *(--stackTop) = (int) ThreadRoot;
     *stack = STACK_FENCEPOST;
 #endif
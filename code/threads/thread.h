@@ -56,14 +56,49 @@
 #define MachineStateSize 75 
 
 
-// Size of the thread's private execution stack.
+// Size of the thread's private execution stack, unless another size is
+// asked for when the thread is created.
 // WATCH OUT IF THIS ISN'T BIG ENOUGH!!!!!
 const int StackSize = (4 * 1024);	// in words
+const int MinStackSize = 256;		// smallest a thread may ask for
 
 
+// How many deleted Thread objects to keep for reuse
+const int MaxFreeThreads = 64;
+
 // Thread state
 enum ThreadStatus { JUST_CREATED, RUNNING, READY, BLOCKED };
 
+// Tickets a thread gets unless told otherwise (see Scheduler::SetTickets)
+const int DefaultTickets = 100;
+
+// What the scheduler keeps track of about a thread's use of the CPU.
+// Times are in ticks.  A CPU burst lasts from when the thread is
+// dispatched until it blocks or finishes; being preempted doesn't
+// end it.
+
+class CpuAccount {
+  public:
+    int predictedBurst;		// guess at the length of the next burst
+    int burstUsed;		// CPU used so far in the current burst,
+				// up to when it was last switched out
+    int dispatchedAt;		// when it last started running
+    int readySince;		// when it last went on the ready list
+    int createdAt;		// when it was first made ready
+    int waitTicks;		// total time spent on the ready list
+    int tickets;		// share of the CPU under Stride and Lottery
+    long long pass;		// for Stride: virtual time it has used
+    int shareSlot;		// where its share is recorded, or -1
+    int lastCpu;		// processor it last ran on, or -1
+    int affinity;		// processor it asked to run on, or -1
+    int inherited;		// best priority donated to it by threads
+				// waiting for its locks, or NotInherited
+};
+
+const int NotInherited = 0x7fffffff;	// no priority has been donated
+
+class Lock;
+
 
 // The following class defines a "thread control block" -- which
 // represents a single thread of execution.
@@ -84,16 +119,27 @@ class Thread {
     void *machineState[MachineStateSize];  // all registers except for stackTop
 
   public:
-    Thread(char* debugName);		// initialize a Thread 
+    Thread(char* debugName, int stackWords = StackSize);
+					// initialize a Thread, whose stack
+					// will hold "stackWords" words
     ~Thread(); 				// deallocate a Thread
 					// NOTE -- thread being deleted
 					// must not be running when delete 
 					// is called
 
+    static void *operator new(size_t size);
+    static void operator delete(void *p);
+					// Thread objects that have been
+					// deleted are kept for the next ones
+
     // basic thread operations
 
     void Fork(VoidFunctionPtr func, void *arg); 
     				// Make thread run (*func)(arg)
+    void Prepare(VoidFunctionPtr func, void *arg);
+				// Set the thread up to run (*func)(arg),
+				// but leave it to the caller to switch
+				// to it
     void Yield();  		// Relinquish the CPU if any 
 				// other thread is runnable
     void Sleep(bool finishing); // Put the thread to sleep and 
@@ -102,25 +148,44 @@ class Thread {
     void Finish();  		// The thread is done executing
     
     void CheckOverflow();   	// Check if thread stack has overflowed
+    int StackUsed();		// Most words of its stack it has used
     void setStatus(ThreadStatus st) { status = st; }
+    ThreadStatus getStatus() { return status; }
     void setBurstTime(int t)	{burstTime = t;}
     int getBurstTime()		{return burstTime;}
     void setPriority(int t)	{priority = t;}
     int getPriority()		{return priority;}
+    int getEffectivePriority()	{return cpu.inherited < priority ?
+					cpu.inherited : priority;}
+				// its own priority, or what it has
+				// inherited, whichever is higher
+    void setLevel(int l)	{level = l;}
+    int getLevel()		{return level;}
+    void setQuantumUsed(int t)	{quantumUsed = t;}
+    int getQuantumUsed()	{return quantumUsed;}
     char* getName() { return (name); }
     void Print() { cout << name; }
     void SelfTest();		// test whether thread impl is working
 
+    CpuAccount cpu;		// for the scheduler
+    Lock *waitingFor;		// lock it is waiting to acquire, or NULL
+    Lock *locksHeld;		// locks it holds, for priority
+				// inheritance (see Lock::Release)
+
   private:
     // some of the private data for this class is listed above
     
     int *stack; 	 	// Bottom of the stack 
 				// NULL if this is the main thread
 				// (If NULL, don't deallocate stack)
+    int stackSize;		// words in "stack" (or to put in it, if
+				// it hasn't been allocated yet)
     ThreadStatus status;	// ready, running or blocked
     char* name;
     int burstTime;
     int priority;	
+    int level;			// MLFQ level, 0 is the highest
+    int quantumUsed;		// timer interrupts used at this level
     void StackAllocate(VoidFunctionPtr func, void *arg);
     				// Allocate a stack for thread.
 				// Used internally by Fork()
@@ -19,95 +19,365 @@
 #include "main.h"
 #include "addrspace.h"
 #include "machine.h"
+#include "frametable.h"
+#include "synch.h"
 #include "noff.h"
 
+extern string algoType;     // 置換演算法，由命令列設定（見 userkernel.cc）
+
 namespace {
 /**
- * 這個類別是一個Noff（Nachos Object Code Format）的讀取器
- * 它的用途是從object file中讀取特定Segment
- * 
- * 該讀取器會依序讀取virtual address [0, PageSize)、[PageSize, 2 * PageSize)...的內容
- * 若讀取範圍和被分配到的Segment有重疊，則會從檔案讀取並寫入outData
+ * 計算virtual page [pageStart, pageStart + PageSize) 和 segment 重疊的部分
+ * 若有重疊，從檔案讀取並寫入outData中對應的位置
+ */
+void ReadSegmentOverlap(OpenFile* file, const Segment& seg, int pageStart, char* outData, const char* name)
+{
+    const int from = max<int>(pageStart, seg.virtualAddr);
+    const int to = min<int>(pageStart + PageSize, seg.virtualAddr + seg.size);
+
+    // read nothing
+    if (seg.size <= 0 || from >= to)
+        return;
+
+    DEBUG(dbgMy, "Read " << to - from << " bytes from inFileAddr: " << seg.inFileAddr + (from - seg.virtualAddr) << " (Segment: " << name << ")");
+    file->ReadAt(outData + (from - pageStart), to - from, seg.inFileAddr + (from - seg.virtualAddr));
+}
+}
+
+
+// Page Replacement Policies ////////////////////////////////////////////////////////////////////////
+
+namespace {
+/**
+ * 置換演算法（page replacement policy）的介面
+ * 演算法只處理physical page的編號，page的use/dirty bit等資訊透過 kernel->frameTable 取得
+ * 只有 FrameTable::IsEvictable 的page可以被選為victim
+ */
+class ReplacementPolicy {
+    public:
+    virtual ~ReplacementPolicy() {}
+
+    /// phyPage 剛被放進memory
+    virtual void PageIn(int phyPage) = 0;
+
+    /// phyPage 被存取，只有 WantsEveryReference() 為true時才會被呼叫
+    virtual void Touch(int phyPage) {}
+
+    /// phyPage 離開memory（被選為victim或address space被刪除）
+    virtual void Remove(int phyPage) = 0;
+
+    /// 選出要被換出去的physical page，但不把它從演算法的資料結構中移除
+    /// 沒有可以換出去的page時回傳-1
+    virtual int SelectVictim() = 0;
+
+    /// 是否需要知道每一次的存取
+    virtual bool WantsEveryReference() const { return false; }
+
+    protected:
+    /// 清掉 entry 的use bit
+    /// translation cache 只在use bit已設定時才會命中，所以要一起讓它失效
+    static void ClearUse(TranslationEntry* entry) {
+        entry->use = false;
+        kernel->machine->InvalidateTranslation(entry);
+    }
+};
+
+/**
+ * FIFO與LRU：以physical page編號串接的雙向串列，串列頭是最新的page，victim是串列尾
+ * FIFO只在page進入memory時放到串列頭；LRU每次存取都移到串列頭。所有操作都是O(1)
+ */
+class ListPolicy : public ReplacementPolicy {
+    int prev[NumPhysPages];
+    int next[NumPhysPages];
+    int head, tail;                 // -1 代表沒有
+    const bool moveOnTouch;         // true 為LRU，false 為FIFO
+
+    void LinkFront(int phyPage) {
+        prev[phyPage] = -1;
+        next[phyPage] = head;
+        if (head != -1)
+            prev[head] = phyPage;
+        else
+            tail = phyPage;
+        head = phyPage;
+    }
+
+    public:
+    ListPolicy(bool lru) : head(-1), tail(-1), moveOnTouch(lru) {}
+
+    void PageIn(int phyPage) override { LinkFront(phyPage); }
+
+    void Touch(int phyPage) override {
+        // 已經在最前面（最常見的情況：連續存取同一個page）
+        if (phyPage == head)
+            return;
+        Remove(phyPage);
+        LinkFront(phyPage);
+    }
+
+    void Remove(int phyPage) override {
+        if (prev[phyPage] != -1)
+            next[prev[phyPage]] = next[phyPage];
+        else
+            head = next[phyPage];
+        if (next[phyPage] != -1)
+            prev[next[phyPage]] = prev[phyPage];
+        else
+            tail = prev[phyPage];
+    }
+
+    int SelectVictim() override {
+        // 從串列尾往前找，跳過正在swap in的page
+        for (int phyPage = tail; phyPage != -1; phyPage = prev[phyPage])
+            if (kernel->frameTable->IsEvictable(phyPage))
+                return phyPage;
+        return -1;
+    }
+
+    bool WantsEveryReference() const override { return moveOnTouch; }
+};
+
+/**
+ * Clock（second chance）：指針繞著所有physical page轉
+ * use bit為1的page清成0、再給一次機會；遇到use bit為0的page就選它
+ * 最多轉兩圈一定找得到
  */
-class NoffReader {
-    OpenFile* const FILE;
-    const char* name;
-    int virtualAddr;		/* location of segment in virt addr space */
-    int inFileAddr;		/* location of segment in this file */
-    int size;			/* size of segment */
+class ClockPolicy : public ReplacementPolicy {
+    protected:
+    int hand = 0;
+
+    void Advance() { hand = (hand + 1) % NumPhysPages; }
 
     public:
-    NoffReader(OpenFile* file, Segment S, const char* name)
-        : FILE(file), name(name), virtualAddr(S.virtualAddr), inFileAddr(S.inFileAddr), size(S.size)
-    {}
-
-    /// 讀出一個Page，如果讀取範圍和分配到的Segment重疊，則讀取並回傳true。否則回傳false。
-    bool ReadOnePage(char* outData) {
-        // read nothing
-        if (virtualAddr < 0 || virtualAddr >= (int)PageSize || size <= 0) {
-            virtualAddr -= PageSize;
-            return false;
+    void PageIn(int phyPage) override {}
+    void Remove(int phyPage) override {}
+
+    int SelectVictim() override {
+        for (unsigned n = 0; n < 2 * NumPhysPages; n++, Advance()) {
+            if (!kernel->frameTable->IsEvictable(hand))
+                continue;
+            TranslationEntry* entry = kernel->frameTable->Entry(hand);
+            if (entry->use)
+                ClearUse(entry);
+            else {
+                int victim = hand;
+                Advance();
+                return victim;
+            }
         }
+        return -1;
+    }
+};
 
-        const int size_to_read = min<int>(PageSize - virtualAddr, size);
-        DEBUG(dbgMy, "Read " << size_to_read << " bytes from inFileAddr: " << inFileAddr << " (Segment: " << name << ")");
-        FILE->ReadAt(outData, size_to_read, inFileAddr);
+/**
+ * Enhanced Clock：依 (use, dirty) 把page分成四類，優先換出 (0,0)，其次 (0,1)
+ * 第1圈找(0,0)，不改任何bit；第2圈找(0,1)，同時清掉經過的use bit；
+ * 再重複一次，最多四圈一定找得到。乾淨的page換出時不需要寫回swap
+ */
+class EnhancedClockPolicy : public ClockPolicy {
+    public:
+    int SelectVictim() override {
+        for (int round = 0; round < 4; round++) {
+            const bool wantDirty = (round % 2 == 1);
+            for (unsigned n = 0; n < NumPhysPages; n++, Advance()) {
+                if (!kernel->frameTable->IsEvictable(hand))
+                    continue;
+                TranslationEntry* entry = kernel->frameTable->Entry(hand);
+                if (!entry->use && entry->dirty == wantDirty) {
+                    int victim = hand;
+                    Advance();
+                    return victim;
+                }
+                if (wantDirty && entry->use)
+                    ClearUse(entry);
+            }
+        }
+        return -1;
+    }
+};
 
-        // update
-        // 下次讀取時，直接寫在outData的最前方（因為Segment是連續的，如果跨多個Page，則在橫跨的第2個page中一定是從頭開始寫）
-        virtualAddr = 0;
-        size -= size_to_read;
-        inFileAddr += size_to_read;
+/**
+ * WSClock：Clock加上working set的概念
+ * 每個physical page記錄最後一次被發現使用的時間（lastUse），超過 WorkingSetWindow 沒被使用的page才不在working set中
+ * 轉一圈的過程中：use bit為1的清掉並更新lastUse；不在working set且乾淨的page直接選它；
+ * 不在working set但dirty的page先記下來（真正的WSClock會在這時排程寫回，再繼續找乾淨的page）
+ * 轉完一圈都沒有乾淨的page，就選第一個dirty的候選；全部都在working set中，則選lastUse最舊的
+ */
+class WSClockPolicy : public ClockPolicy {
+    static const int WorkingSetWindow = 1000;   // ticks
+    int lastUse[NumPhysPages];
 
-        return true;
+    public:
+    void PageIn(int phyPage) override { lastUse[phyPage] = kernel->stats->totalTicks; }
+
+    int SelectVictim() override {
+        const int now = kernel->stats->totalTicks;
+        int candidate = -1;
+        int oldest = -1;
+
+        for (unsigned n = 0; n < NumPhysPages; n++, Advance()) {
+            if (!kernel->frameTable->IsEvictable(hand))
+                continue;
+            TranslationEntry* entry = kernel->frameTable->Entry(hand);
+            if (entry->use) {
+                ClearUse(entry);
+                lastUse[hand] = now;
+            }
+            else if (now - lastUse[hand] > WorkingSetWindow) {
+                if (!entry->dirty) {
+                    int victim = hand;
+                    Advance();
+                    return victim;
+                }
+                if (candidate == -1)
+                    candidate = hand;
+            }
+            if (oldest == -1 || lastUse[hand] < lastUse[oldest])
+                oldest = hand;
+        }
+        return candidate != -1 ? candidate : oldest;
     }
 };
+
+/// 依命令列參數（algoType）建立置換演算法，第一次使用時才建立
+ReplacementPolicy* Policy()
+{
+    static ReplacementPolicy* policy = nullptr;
+
+    if (policy == nullptr) {
+        if (algoType == "LRU")
+            policy = new ListPolicy(true);
+        else if (algoType == "CLOCK")
+            policy = new ClockPolicy();
+        else if (algoType == "ECLOCK")
+            policy = new EnhancedClockPolicy();
+        else if (algoType == "WSCLOCK")
+            policy = new WSClockPolicy();
+        else
+            policy = new ListPolicy(false);
+    }
+    return policy;
+}
 }
 
 
 // Static Member of AddrSpace ///////////////////////////////////////////////////////////////////////
 
-bool AddrSpace::usedPhyPage[NumPhysPages] = {0};
-std::list<TranslationEntry*> AddrSpace::pageList;
-
-bool AddrSpace::IsPhyPageUsed(size_t index)
+bool AddrSpace::WantsEveryReference()
 {
-    ASSERT(0 <= index && index < NumPhysPages);
-    return usedPhyPage[index];
+    return Policy()->WantsEveryReference();
 }
 
 unsigned int AddrSpace::SwapOutLastPage()
 {
-    TranslationEntry* curPage = pageList.back();
+    const int victim = Policy()->SelectVictim();
+    ASSERT(victim != -1);
+    DEBUG(dbgMy, "Replacement policy chose physical page " << victim);
+    EvictFrame(victim);
+    return victim;
+}
+
+void AddrSpace::EvictFrame(int victim)
+{
+    TranslationEntry* curPage = kernel->frameTable->Entry(victim);
+    ASSERT(curPage != nullptr);
     /**
-     * pop_back放在這裡是必要的，因為在SwapOut時，NachOS會讓目前的執行緒（下稱A）休息直到硬碟的寫入完成
+     * Remove和Unmap放在這裡是必要的，因為在SwapOut時，NachOS會讓目前的執行緒（下稱A）休息直到硬碟的寫入完成
      * 在休息的期間可能會切換到其他的執行緒（下稱B）
-     * 若B也發生page fault，那B看到的pageList.back()必須和A看到的不一樣，不然同個physical page會被swap out兩次
+     * 若B也發生page fault，那B的置換演算法不能再選到同一個page，不然同個physical page會被swap out兩次
+     * Unmap後frame保持reserved，不會回到free list，所以也不會被B拿走
      */
-    pageList.pop_back();
+    Policy()->Remove(victim);
+    kernel->frameTable->Unmap(victim);
 
     curPage->SwapOut();
     curPage->valid = false;
-    // 在swap out完成前必須持續佔用curPage->physicalPage，避免其他thread想要佔用它
-    usedPhyPage[curPage->physicalPage] = false;
-    
-    return curPage->physicalPage;
+    kernel->machine->InvalidateTranslation(curPage);
+}
+
+// Pageout Daemon ///////////////////////////////////////////////////////////////////////////////////
+
+int AddrSpace::pageoutLowWater = 0;
+Semaphore* AddrSpace::pageoutWakeup = nullptr;
+bool AddrSpace::pageoutIdle = true;
+
+void AddrSpace::StartPageoutDaemon(int lowWater)
+{
+    ASSERT(0 < lowWater && lowWater < (int)NumPhysPages);
+    ASSERT(pageoutWakeup == nullptr);
+
+    pageoutLowWater = lowWater;
+    kernel->stats->pageoutLowWater = lowWater;
+    pageoutWakeup = new Semaphore("pageout", 0);
+
+    Thread* daemon = new Thread("pageout");
+    daemon->Fork((VoidFunctionPtr) &AddrSpace::PageoutDaemon, nullptr);
+}
+
+void AddrSpace::CheckFreeFrames()
+{
+    if (pageoutLowWater > 0 && pageoutIdle && kernel->frameTable->NumFree() < pageoutLowWater) {
+        pageoutIdle = false;
+        kernel->stats->numPageoutWakeups++;
+        pageoutWakeup->V();
+    }
+}
+
+void AddrSpace::PageoutDaemon(void*)
+{
+    for (;;) {
+        pageoutWakeup->P();
+        DEBUG(dbgMy, "Pageout daemon woke up, " << kernel->frameTable->NumFree() << " free frames");
+
+        /**
+         * 每次選一個victim：
+         * 1. dirty的page先寫回swap，但仍留在memory中，寫回期間owner可以繼續使用它（寫入會再設定dirty）
+         *    寫回完成後不馬上釋放，下一輪置換演算法會再決定要不要選它
+         * 2. 乾淨的page直接釋放，不需要任何I/O
+         * 為了避免一直被修改的page讓daemon停不下來，每次被叫醒最多處理NumPhysPages個page
+         */
+        for (unsigned tries = 0; tries < NumPhysPages && kernel->frameTable->NumFree() < pageoutLowWater; tries++) {
+            const int victim = Policy()->SelectVictim();
+            if (victim == -1)
+                break;
+            TranslationEntry* entry = kernel->frameTable->Entry(victim);
+
+            if (entry->dirty) {
+                DEBUG(dbgMy, "Pageout daemon cleaning physical page " << victim);
+                // 清掉dirty bit並讓translation cache失效，寫回期間的寫入才會重新設定dirty
+                entry->dirty = false;
+                kernel->machine->InvalidateTranslation(entry);
+                kernel->frameTable->Pin(victim);
+                entry->WriteBack();
+                kernel->frameTable->Unpin(victim);
+                kernel->stats->numPageoutWrites++;
+            }
+            else {
+                DEBUG(dbgMy, "Pageout daemon freeing physical page " << victim);
+                EvictFrame(victim);
+                kernel->frameTable->Free(victim);
+                kernel->stats->numPageoutFrees++;
+            }
+        }
+        pageoutIdle = true;
+    }
 }
 
 
 void AddrSpace::LRU_Algo(TranslationEntry* entry)
 {
-    pageList.remove(entry);
-    pageList.push_front(entry);
+    const int phyPage = entry->physicalPage;
+
+    // 正在被swap out的page已經不歸任何人所有
+    if (kernel->frameTable->Entry(phyPage) != entry)
+        return;
+    Policy()->Touch(phyPage);
 }
 
 void AddrSpace::UseFreePhyPage(size_t phyPage, TranslationEntry *entry)
 {
-    ASSERT(!AddrSpace::IsPhyPageUsed(phyPage));
-    ASSERT(pageList.size() < NumPhysPages);
-
-    // mark as used
-    AddrSpace::usedPhyPage[phyPage] = true;
+    ASSERT(kernel->frameTable->State(phyPage) == FrameReserved);
+    ASSERT(entry >= pageTable && entry < pageTable + numPages);
 
     // edit entry
     entry->physicalPage = phyPage;
@@ -115,10 +385,13 @@ void AddrSpace::UseFreePhyPage(size_t phyPage, TranslationEntry *entry)
     entry->use = false;
     entry->dirty = false;
 
-    // TODO: Add entry into "page list"
-    pageList.push_front(entry);
-    // TODO: Swap in entry if needed
+    // 加入frame table和置換演算法
+    // SwapIn可能會讓執行緒休息（讀取硬碟），在完成前不能被其他執行緒選為victim
+    kernel->frameTable->Map(phyPage, this, entry);
+    kernel->frameTable->Pin(phyPage);
+    Policy()->PageIn(phyPage);
     entry->SwapIn();
+    kernel->frameTable->Unpin(phyPage);
 }
 
 //----------------------------------------------------------------------
@@ -156,6 +429,8 @@ AddrSpace::AddrSpace()
 {
     pageTable = nullptr;
     numPages = 0;
+    executable = nullptr;
+    noffH = new NoffHeader;
     
     // zero out the entire address space
 //    bzero(kernel->machine->mainMemory, MemorySize);
@@ -168,15 +443,26 @@ AddrSpace::AddrSpace()
 
 AddrSpace::~AddrSpace()
 {
-   for(int i = 0; i < numPages; i++)
-        AddrSpace::usedPhyPage[pageTable[i].physicalPage] = false;
+   for(int i = 0; i < numPages; i++) {
+        const int phyPage = pageTable[i].physicalPage;
+        // 只有還在memory中的page才佔用physical page，要從置換演算法中移除並還給frame table
+        if (pageTable[i].valid && kernel->frameTable->Entry(phyPage) == &pageTable[i]) {
+            Policy()->Remove(phyPage);
+            kernel->frameTable->Free(phyPage);
+        }
+   }
    delete pageTable;
+   kernel->machine->FlushTranslations();
+   delete executable;
+   delete noffH;
 }
 
 
 //----------------------------------------------------------------------
 // AddrSpace::Load
-// 	Load a user program into memory from a file.
+// 	Load a user program into memory from a file.  Only the page
+//	table is set up here; each page is read from the file (or
+//	zero-filled) by the page fault handler the first time it is used.
 //
 //	Assumes that the page table has been initialized, and that
 //	the object code file is in NOFF format.
@@ -212,68 +498,49 @@ AddrSpace::Load(char *fileName)
     numPages = divRoundUp(size,PageSize);
     delete pageTable; // prevent memory leak, if someone loads the file twice
     pageTable = new TranslationEntry[numPages];
+    kernel->machine->FlushTranslations();
 
     // 將pageTable和numPages傳給kernel->machine，避免它會用到
     kernel->machine->pageTable = this->pageTable;
     kernel->machine->pageTableSize = this->numPages;
 
-    for(unsigned int i=0, j=0; i<numPages; i++){
-        pageTable[i].virtualPage = i;
-        while(j<NumPhysPages && AddrSpace::IsPhyPageUsed(j))
-            j++;
+    DEBUG(dbgMy, "Initializing address space: " << numPages << ", " << numPages * PageSize);
+    DEBUG(dbgMy, "Initializing code segment: " << noffH.code.virtualAddr << ", " << noffH.code.size << ", " << noffH.code.inFileAddr);
+    DEBUG(dbgMy, "Initializing data segment: " << noffH.initData.virtualAddr << ", " << noffH.initData.size << ", " << noffH.initData.inFileAddr);
 
-        // there is an empty physical page
-        if (j < NumPhysPages) {
-            AddrSpace::UseFreePhyPage(j, pageTable + i);
-        }
-        // no empty physical page
-        else {
-            pageTable[i].physicalPage = 0;
-            // Invalid, PageFault will occur when reading or writing
-            pageTable[i].valid = false;
-        }
-        
+    // 所有page一開始都不在memory中，第一次存取時才由page fault載入（見 TranslationEntry::SwapIn）
+    for(unsigned int i=0; i<numPages; i++){
+        pageTable[i].virtualPage = i;
+        pageTable[i].physicalPage = 0;
+        // Invalid, PageFault will occur when reading or writing
+        pageTable[i].valid = false;
         pageTable[i].use = false;
         pageTable[i].dirty = false;
         pageTable[i].readOnly = false;
-    }
 
-    this->InitPages(executable, noffH);
+        // 和code或initData重疊的page從執行檔讀取，其他的（uninitData、stack）填0
+        const int pageStart = i * PageSize;
+        const int pageEnd = pageStart + PageSize;
+        if ((noffH.code.size > 0 && noffH.code.virtualAddr < pageEnd 
+                && pageStart < noffH.code.virtualAddr + noffH.code.size)
+            || (noffH.initData.size > 0 && noffH.initData.virtualAddr < pageEnd 
+                && pageStart < noffH.initData.virtualAddr + noffH.initData.size))
+            pageTable[i].SetFileBacked(this);
+    }
 
-    delete executable;			// close file
+    // 執行檔要留到address space被刪除時才關閉
+    delete this->executable;
+    this->executable = executable;
+    *this->noffH = noffH;
     return TRUE;			// success
 }
 
-void AddrSpace::InitPages(OpenFile* executable, const noffHeader& noffH) {
-    DEBUG(dbgMy, "Initializing address space: " << numPages << ", " << numPages * PageSize);
-    DEBUG(dbgMy, "Initializing code segment: " << noffH.code.virtualAddr << ", " << noffH.code.size << ", " << noffH.code.inFileAddr);
-    DEBUG(dbgMy, "Initializing data segment: " << noffH.initData.virtualAddr << ", " << noffH.initData.size << ", " << noffH.initData.inFileAddr);
-
-    // 如果沒有對應的physical page，則將內容暫存於此
-    char buffer[PageSize] = { '\0' };
-    char* outData = nullptr;
-    NoffReader code(executable, noffH.code, "code"), initData(executable, noffH.initData, "initData");
-
-    for (unsigned i = 0; i < numPages; i++) {
-        // 有對應的physical page，直接寫入mainMemory
-        if (pageTable[i].valid) {
-            DEBUG(dbgMy, i << " valid");
-            outData = kernel->machine->mainMemory + (pageTable[i].physicalPage * PageSize);
-        }
-        else {
-            DEBUG(dbgMy, i << " invalid");
-            outData = buffer;
-            memset(buffer, 0, PageSize);
-        }
-
-        code.ReadOnePage(outData);
-        initData.ReadOnePage(outData);
+void AddrSpace::ReadPageFromFile(unsigned int vpn, char* outData)
+{
+    ASSERT(executable != nullptr && vpn < numPages);
 
-        if (!pageTable[i].valid) {
-            pageTable[i].SwapOutData(outData);
-            ASSERT(!pageTable[i].valid);
-        }
-    }
+    ReadSegmentOverlap(executable, noffH->code, vpn * PageSize, outData, "code");
+    ReadSegmentOverlap(executable, noffH->initData, vpn * PageSize, outData, "initData");
 }
 
 //----------------------------------------------------------------------
@@ -363,4 +630,5 @@ void AddrSpace::RestoreState()
 {
     kernel->machine->pageTable = pageTable;
     kernel->machine->pageTableSize = numPages;
+    kernel->machine->PageTableChanged();
 }
@@ -16,56 +16,71 @@
 #include "copyright.h"
 #include "filesys.h"
 #include <string.h>
-#include <list>
 
 #define UserStackSize		1024 	// increase this as necessary!
 struct noffHeader;
+class Semaphore;
 
 class AddrSpace {
   public:
     AddrSpace();			// Create an address space.
     ~AddrSpace();			// De-allocate an address space
 
-    /// 檢查第 index 個 physical page 是否被使用
-    /// Pre: `0 <= index && index < NumPhysPages`
-    static bool IsPhyPageUsed(size_t index);
-
-    /// 讓 entry 代表的 virtual page 使用第 index 個 physical page
-    /// Pre: `!IsPhyPageUsed(phyPage)`
+    /// 讓 entry 代表的 virtual page 使用第 phyPage 個 physical page，並載入它的內容
+    /// Pre: phyPage 是從 kernel->frameTable 拿到的reserved frame，entry 屬於這個address space
     /// Post: valid == true, use == false, dirty == false
-    static void UseFreePhyPage(size_t phyPage, TranslationEntry* entry);
+    void UseFreePhyPage(size_t phyPage, TranslationEntry* entry);
 
+    /// 用置換演算法選出一個page並swap out，回傳空出來的physical page（保持reserved）
     static unsigned int SwapOutLastPage();
 
+    /// 建立pageout daemon，讓free frame的數量盡量維持在 lowWater 以上
+    /// Pre: `0 < lowWater && lowWater < NumPhysPages`
+    static void StartPageoutDaemon(int lowWater);
+
+    /// 從frame table拿走free frame後呼叫，free frame不夠時叫醒pageout daemon
+    static void CheckFreeFrames();
+
     void Execute(char *fileName);	// Run the the program
 					// stored in the file "executable"
 
-    // LRU implement
+    /// 通知置換演算法 entry 被存取了（只有需要每次存取資訊的演算法，即LRU，才會被呼叫）
     static void LRU_Algo(TranslationEntry* entry);
 
+    /// 目前的置換演算法是否需要知道每一次的存取（見 LRU_Algo）
+    static bool WantsEveryReference();
+
+    /// 把執行檔中屬於第 vpn 個virtual page的部分（code、initData）讀進 outData
+    /// outData 中不屬於任何segment的部分不會被修改
+    void ReadPageFromFile(unsigned int vpn, char* outData);
+
     void SaveState();			// Save/restore address space-specific
     void RestoreState();		// info on a context switch 
 
   private:
-    /// record which physical pages are used
-    static bool usedPhyPage[NumPhysPages];
+    /// 把 victim 中的page swap out（dirty才寫回），frame保持reserved
+    static void EvictFrame(int victim);
 
-    // record which pages are in the memory
-    static std::list<TranslationEntry*> pageList;
+    /// pageout daemon的參數和狀態（見 StartPageoutDaemon）
+    static int pageoutLowWater;
+    static Semaphore* pageoutWakeup;
+    static bool pageoutIdle;
+    static void PageoutDaemon(void*);
 
     /// Assume linear page table translation for now!
     TranslationEntry *pageTable;
     /// Number of pages in the virtual address space
     unsigned int numPages;
 
+    /// 執行檔和它的header，page第一次被存取時才從這裡讀取（lazy loading）
+    OpenFile *executable;
+    noffHeader *noffH;
+
     bool Load(char *fileName);		// Load the program into memory
 					// return false if not found
 
     void InitRegisters();		// Initialize user-level CPU registers,
 					// before jumping to user code
-
-    /// Copy the code and data segments into memory or disk
-    void InitPages(OpenFile* executable, const noffHeader& noffH);
 };
 
 #endif // ADDRSPACE_H
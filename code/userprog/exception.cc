@@ -68,6 +68,15 @@ ExceptionHandler(ExceptionType which)
 			val=kernel->machine->ReadRegister(4);
 			cout << "Print integer:" <<val << endl;
 			return;
+		case SC_SetTickets:
+			val=kernel->machine->ReadRegister(4);
+			if (val > 0) {
+				kernel->scheduler->SetTickets(kernel->currentThread, val);
+				kernel->machine->WriteRegister(2, 0);
+			} else {
+				kernel->machine->WriteRegister(2, -1);
+			}
+			return;
 /*		case SC_Exec:
 			DEBUG(dbgAddr, "Exec\n");
 			val = kernel->machine->ReadRegister(4);
@@ -90,20 +99,17 @@ ExceptionHandler(ExceptionType which)
 	case PageFaultException:
 		ASSERT(Page_Fault_Entry != nullptr);
 		kernel->stats->numPageFaults++;
-
-		for(int i = 0; i < NumPhysPages; ++i)
 		{
-			if(!AddrSpace::IsPhyPageUsed(i))
-			{
-				AddrSpace::UseFreePhyPage(i, Page_Fault_Entry);
-				Page_Fault_Entry = nullptr;
-				return;
-			}
-		}
-		{
-			unsigned int freePage = AddrSpace::SwapOutLastPage();
-			AddrSpace::UseFreePhyPage(freePage, Page_Fault_Entry);
+			// SwapOutLastPage可能會讓執行緒休息，其他執行緒的page fault會覆蓋Page_Fault_Entry
+			TranslationEntry* faultEntry = Page_Fault_Entry;
 			Page_Fault_Entry = nullptr;
+
+			int freePage = kernel->frameTable->Allocate();
+			// no free physical page
+			if (freePage == -1)
+				freePage = AddrSpace::SwapOutLastPage();
+			AddrSpace::CheckFreeFrames();
+			kernel->currentThread->space->UseFreePhyPage(freePage, faultEntry);
 		}
 		return;
 	default:
@@ -0,0 +1,138 @@
+// frametable.cc
+//	Routines to keep track of the physical page frames used by
+//	user programs.  See frametable.h for the states a frame goes
+//	through.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "frametable.h"
+#include "main.h"
+
+//----------------------------------------------------------------------
+// FrameTable::FrameTable
+// 	Initialize the frame table, with every frame free.  The free
+//	list is built so that frames are handed out lowest first.
+//----------------------------------------------------------------------
+
+FrameTable::FrameTable()
+{
+    freeHead = -1;
+    for (int i = NumPhysPages - 1; i >= 0; i--) {
+	frames[i].space = NULL;
+	frames[i].vpn = 0;
+	frames[i].entry = NULL;
+	frames[i].pinCount = 0;
+	frames[i].state = FrameFree;
+	frames[i].nextFree = freeHead;
+	freeHead = i;
+    }
+    numFree = NumPhysPages;
+    numInUse = 0;
+    kernel->stats->minFreeFrames = numFree;
+}
+
+//----------------------------------------------------------------------
+// FrameTable::Allocate
+// 	Take a frame off the free list, and reserve it for the caller.
+//	Returns -1 if there are no free frames; the caller must then
+//	make one by replacing a page.
+//----------------------------------------------------------------------
+
+int
+FrameTable::Allocate()
+{
+    int frame = freeHead;
+
+    if (frame == -1)
+	return -1;
+    ASSERT(frames[frame].state == FrameFree);
+    freeHead = frames[frame].nextFree;
+    frames[frame].state = FrameReserved;
+    numFree--;
+    if (numFree < kernel->stats->minFreeFrames)
+	kernel->stats->minFreeFrames = numFree;
+    DEBUG(dbgAddr, "Allocated frame " << frame << ", " << numFree << " left");
+    return frame;
+}
+
+//----------------------------------------------------------------------
+// FrameTable::Free
+// 	Put a frame back on the free list.  If it still holds a page,
+//	the page must already have been marked invalid.
+//----------------------------------------------------------------------
+
+void
+FrameTable::Free(int frame)
+{
+    ASSERT(0 <= frame && frame < (int) NumPhysPages);
+    ASSERT(frames[frame].state != FrameFree && frames[frame].pinCount == 0);
+
+    if (frames[frame].state == FrameInUse)
+	numInUse--;
+    frames[frame].space = NULL;
+    frames[frame].entry = NULL;
+    frames[frame].state = FrameFree;
+    frames[frame].nextFree = freeHead;
+    freeHead = frame;
+    numFree++;
+}
+
+//----------------------------------------------------------------------
+// FrameTable::Map
+// 	Record that a reserved frame now holds page "entry" of "space".
+//----------------------------------------------------------------------
+
+void
+FrameTable::Map(int frame, AddrSpace *space, TranslationEntry *entry)
+{
+    ASSERT(0 <= frame && frame < (int) NumPhysPages);
+    ASSERT(frames[frame].state == FrameReserved);
+
+    frames[frame].space = space;
+    frames[frame].vpn = entry->virtualPage;
+    frames[frame].entry = entry;
+    frames[frame].state = FrameInUse;
+    numInUse++;
+}
+
+//----------------------------------------------------------------------
+// FrameTable::Unmap
+// 	The page in "frame" is being replaced.  The frame stays reserved
+//	for the caller, who will hand it to another page or free it.
+//----------------------------------------------------------------------
+
+void
+FrameTable::Unmap(int frame)
+{
+    ASSERT(0 <= frame && frame < (int) NumPhysPages);
+    ASSERT(frames[frame].state == FrameInUse);
+
+    frames[frame].space = NULL;
+    frames[frame].entry = NULL;
+    frames[frame].state = FrameReserved;
+    numInUse--;
+}
+
+//----------------------------------------------------------------------
+// FrameTable::Pin, FrameTable::Unpin
+// 	Keep "frame" from being chosen for replacement, e.g. while its
+//	page is being read in.  Pins nest.
+//----------------------------------------------------------------------
+
+void
+FrameTable::Pin(int frame)
+{
+    ASSERT(0 <= frame && frame < (int) NumPhysPages);
+    frames[frame].pinCount++;
+}
+
+void
+FrameTable::Unpin(int frame)
+{
+    ASSERT(0 <= frame && frame < (int) NumPhysPages);
+    ASSERT(frames[frame].pinCount > 0);
+    frames[frame].pinCount--;
+}
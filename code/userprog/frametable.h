@@ -0,0 +1,84 @@
+// frametable.h
+//	Data structures to keep track of the physical page frames used
+//	by user programs (a "core map").
+//
+//	There is one entry per frame in main memory, recording which
+//	page of which address space lives there, whether it may be
+//	chosen for replacement, and whether it is free.  Free frames
+//	are kept on a list threaded through the entries, so allocating
+//	or freeing a frame takes constant time regardless of how many
+//	frames there are.
+//
+//	A frame goes through three states:
+//
+//	    FrameFree -- on the free list
+//	    FrameReserved -- handed out by Allocate (or taken away from
+//		its page by Unmap), but not holding a page yet: its
+//		contents are being read in or written out
+//	    FrameInUse -- holding a page of an address space
+//
+//	Only frames in use and not pinned may be chosen as victims
+//	by the page replacement algorithm.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef FRAMETABLE_H
+#define FRAMETABLE_H
+
+#include "copyright.h"
+#include "machine.h"
+
+class AddrSpace;
+
+enum FrameState { FrameFree, FrameReserved, FrameInUse };
+
+class FrameTable {
+  public:
+    FrameTable();			// Every frame starts out free
+
+    int Allocate();			// Take a frame off the free list;
+					// -1 if there is none
+    void Free(int frame);		// Put a frame back on the free list
+
+    void Map(int frame, AddrSpace *space, TranslationEntry *entry);
+					// A reserved frame now holds the page
+					// "entry" of "space"
+    void Unmap(int frame);		// The page is leaving the frame; keep
+					// the frame reserved for the caller
+
+    void Pin(int frame);		// Keep the frame from being replaced
+    void Unpin(int frame);		// (pins nest)
+
+    bool IsEvictable(int frame) { return frames[frame].state == FrameInUse
+					&& frames[frame].pinCount == 0; }
+    TranslationEntry *Entry(int frame) { return frames[frame].entry; }
+					// page held by a frame; NULL if it
+					// isn't in use
+    AddrSpace *Space(int frame) { return frames[frame].space; }
+    FrameState State(int frame) { return frames[frame].state; }
+
+    int NumFree() { return numFree; }	// frames on the free list
+    int NumInUse() { return numInUse; }	// frames holding a page
+
+  private:
+    class Frame {
+      public:
+	AddrSpace *space;		// address space owning the page
+	unsigned int vpn;		// virtual page number in "space"
+	TranslationEntry *entry;	// the page table entry for "vpn",
+					// so the replacement algorithm can
+					// get at the use and dirty bits
+	int pinCount;			// > 0 if the frame may not be replaced
+	FrameState state;
+	int nextFree;			// next frame on the free list, or -1
+    };
+
+    Frame frames[NumPhysPages];
+    int freeHead;			// first free frame, or -1
+    int numFree;
+    int numInUse;
+};
+
+#endif // FRAMETABLE_H
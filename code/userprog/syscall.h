@@ -30,6 +30,7 @@
 #define SC_ThreadFork	9
 #define SC_ThreadYield	10
 #define SC_PrintInt	11
+#define SC_SetTickets	12
 
 #ifndef IN_ASM
 
@@ -128,6 +129,12 @@ void ThreadFork(void (*func)());
 void ThreadYield();		
 
 void PrintInt(int number);	//my System Call
+
+/* Ask for a share of the CPU in proportion to "tickets", under the
+ * Stride and Lottery schedulers.  Returns 0, or -1 if "tickets" isn't
+ * positive.
+ */
+int SetTickets(int tickets);
 #endif /* IN_ASM */
 
 #endif /* SYSCALL_H */
@@ -10,6 +10,7 @@
 #include "synchconsole.h"
 #include "userkernel.h"
 #include "synchdisk.h"
+#include "blockcompiler.h"
 
 //----------------------------------------------------------------------
 // UserProgKernel::UserProgKernel
@@ -23,31 +24,83 @@ UserProgKernel::UserProgKernel(int argc, char **argv)
 		: ThreadedKernel(argc, argv)
 {
     debugUserProg = FALSE;
+    useBlocks = FALSE;
+    blockHotThreshold = 0;	// 0 means use the engine's default
+    blockCacheSize = 0;
+    hostParallel = FALSE;
+    pageoutLowWater = 0;
 	execfileNum=0;
     for (int i = 1; i < argc; i++) {
 			if (strcmp(argv[i], "-s") == 0) {
 			debugUserProg = TRUE;
 		}
+		else if (strcmp(argv[i], "-bb") == 0) {
+			useBlocks = TRUE;
+		}
+		else if (strcmp(argv[i], "-bbhot") == 0) {
+			ASSERT(i + 1 < argc);
+			useBlocks = TRUE;
+			blockHotThreshold = atoi(argv[i + 1]);
+			i++;
+		}
+		else if (strcmp(argv[i], "-bbcache") == 0) {
+			ASSERT(i + 1 < argc);
+			useBlocks = TRUE;
+			blockCacheSize = atoi(argv[i + 1]) * 1024;
+			i++;
+		}
+		else if (strcmp(argv[i], "-parallel") == 0) {
+			hostParallel = TRUE;
+		}
+		else if (strcmp(argv[i], "-pageout") == 0) {
+			ASSERT(i + 1 < argc);
+			pageoutLowWater = atoi(argv[i + 1]);
+			i++;
+		}
 		else if (strcmp(argv[i], "-e") == 0) {
 			execfile[++execfileNum]= argv[i + 1];
+			execTickets[execfileNum] = 0;
+			execAffinity[execfileNum] = -1;
+		}
+		else if (strcmp(argv[i], "-tickets") == 0) {
+			ASSERT(i + 1 < argc && execfileNum > 0);
+			execTickets[execfileNum] = atoi(argv[i + 1]);
+			ASSERT(execTickets[execfileNum] > 0);
+			i++;
+		}
+		else if (strcmp(argv[i], "-affinity") == 0) {
+			ASSERT(i + 1 < argc && execfileNum > 0);
+			execAffinity[execfileNum] = atoi(argv[i + 1]);
+			ASSERT(0 <= execAffinity[execfileNum] 
+					&& execAffinity[execfileNum] < MaxCpus);
+			i++;
 		}
 			else if (strcmp(argv[i], "-u") == 0) {
 			cout << "===========The following argument is defined in userkernel.cc" << endl;
 			cout << "Partial usage: nachos [-s]\n";
 			cout << "Partial usage: nachos [-u]" << endl;
-			cout << "Partial usage: nachos [-e] filename" << endl;
+			cout << "Partial usage: nachos [-e] filename [-tickets count] [-affinity cpu]" << endl;
+			cout << "Partial usage: nachos [-bb] [-bbhot count] [-bbcache KB] [-pageout frames]" << endl;
+			cout << "Partial usage: nachos [-parallel]" << endl;
 		}
 		else if (strcmp(argv[i], "-h") == 0) {
 			cout << "argument 's' is for debugging. Machine status  will be printed " << endl;
 			cout << "argument 'e' is for execting file." << endl;
+			cout << "argument 'tickets' sets the CPU share of the file before it (-sche STRIDE or LOTTERY)." << endl;
 			cout << "atgument 'u' will print all argument usage." << endl;
+			cout << "argument 'bb' runs user programs a basic block at a time." << endl;
+			cout << "argument 'bbhot' sets how often a block runs before it is translated." << endl;
+			cout << "argument 'bbcache' sets the size of the translated block cache in KB." << endl;
+			cout << "argument 'pageout' keeps that many free frames (less than " << NumPhysPages << ") with a pageout daemon." << endl;
+			cout << "argument 'LRU', 'CLOCK', 'ECLOCK' or 'WSCLOCK' selects the page replacement algorithm (default FIFO)." << endl;
 			cout << "For example:" << endl;
 			cout << "	./nachos -s : Print machine status during the machine is on." << endl;
 			cout << "	./nachos -e file1 -e file2 : executing file1 and file2."  << endl;
 		}
-		else if(strcmp(argv[i], "LRU") == 0)
+		else if(strcmp(argv[i], "LRU") == 0 || strcmp(argv[i], "CLOCK") == 0 ||
+				strcmp(argv[i], "ECLOCK") == 0 || strcmp(argv[i], "WSCLOCK") == 0)
 		{
-			algoType = "LRU";
+			algoType = argv[i];
 		}
     }
 }
@@ -62,8 +115,25 @@ UserProgKernel::Initialize()
 {
     ThreadedKernel::Initialize();	// init multithreading
 
-    machine = new Machine(debugUserProg);
+    for (int n = 1; n <= execfileNum; n++) {
+	if (execAffinity[n] >= scheduler->NumCpus()) {
+	    cout << "-affinity " << execAffinity[n] << " for " << execfile[n]
+		 << ": there are only " << scheduler->NumCpus() 
+		 << " processors (-cpus)\n";
+	    Exit(1);
+	}
+    }
+    if (pageoutLowWater < 0 || pageoutLowWater >= (int) NumPhysPages) {
+	cout << "-pageout " << pageoutLowWater << ": must be from 0 (no daemon)"
+	     << " to " << NumPhysPages - 1 << " frames; there are only "
+	     << NumPhysPages << "\n";
+	Exit(1);
+    }
+
+    machine = new Machine(debugUserProg, useBlocks, blockHotThreshold,
+			  blockCacheSize, hostParallel);
     fileSystem = new FileSystem();
+    frameTable = new FrameTable();
 #ifdef FILESYS
     synchDisk = new SynchDisk("New SynchDisk");
 #endif // FILESYS
@@ -78,6 +148,7 @@ UserProgKernel::Initialize()
 UserProgKernel::~UserProgKernel()
 {
     delete fileSystem;
+    delete frameTable;
     delete machine;
 #ifdef FILESYS
     delete synchDisk;
@@ -98,11 +169,18 @@ void
 UserProgKernel::Run()
 {
 
+	if (pageoutLowWater > 0)
+		AddrSpace::StartPageoutDaemon(pageoutLowWater);
+
 	cout << "Total threads number is " << execfileNum << endl;
 	for (int n=1;n<=execfileNum;n++)
 		{
 		t[n] = new Thread(execfile[n]);
 		t[n]->space = new AddrSpace();
+		if (execTickets[n] > 0)
+			scheduler->SetTickets(t[n], execTickets[n]);
+		if (execAffinity[n] >= 0)
+			scheduler->SetAffinity(t[n], execAffinity[n]);
 		t[n]->Fork((VoidFunctionPtr) &ForkExecute, (void *)t[n]);
 		cout << "Thread " << execfile[n] << " is executing." << endl;
 		}
@@ -156,4 +234,7 @@ UserProgKernel::SelfTest() {
 
 
 //	cout << "This is self test message from UserProgKernel\n" ;
+#ifdef x86
+    BlockCompiler::SelfTest();	// test translation to i386 code
+#endif
 }
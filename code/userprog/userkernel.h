@@ -16,6 +16,7 @@
 #include "filesys.h"
 #include "machine.h"
 #include "synchdisk.h"
+#include "frametable.h"
 class SynchDisk;
 class UserProgKernel : public ThreadedKernel {
   public:
@@ -32,6 +33,7 @@ class UserProgKernel : public ThreadedKernel {
 // These are public for notational convenience.
     Machine *machine;
     FileSystem *fileSystem;
+    FrameTable *frameTable;	// which page is in each physical frame
 
 #ifdef FILESYS
     SynchDisk *synchDisk;
@@ -39,8 +41,17 @@ class UserProgKernel : public ThreadedKernel {
 
   private:
     bool debugUserProg;		// single step user program
+    bool useBlocks;		// run user code with the basic-block engine
+    int blockHotThreshold;	// entries before a block is translated
+    int blockCacheSize;		// bytes of translated blocks to keep
+    bool hostParallel;		// run the processors' user code on
+				// host threads (-parallel)
+    int pageoutLowWater;	// free frames the pageout daemon keeps,
+				// 0 for no daemon
 	Thread* t[10];
 	char*	execfile[10];
+	int	execTickets[10];	// tickets for each, 0 for the default
+	int	execAffinity[10];	// processor each asked for, or -1
 	int	execfileNum;
 };
 